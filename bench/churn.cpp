@@ -0,0 +1,119 @@
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <memory_resource>
+#include <spanstream>
+#include <string>
+#include <vector>
+#include "../sdk/Reader"
+
+using Id::Pack::Reader;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * The number of files in each archive read by the benchmark, and the number of them to read each time it's opened.
+     */
+    constexpr int FileCount = 2000;
+    constexpr int FilesReadPerOpen = 8;
+
+    /** Append a little-endian uint32 to a byte buffer. */
+    void appendUint32(std::string & out, std::uint32_t value)
+    {
+        for (int byte = 0; byte < 4; ++byte) {
+            out.push_back(static_cast<char>((value >> (8 * byte)) & 0xff));
+        }
+    }
+
+    /** Build a PACK archive in memory, with small files of varying size. */
+    std::string buildArchive()
+    {
+        std::string content;
+        std::string index;
+
+        for (int idx = 0; idx < FileCount; ++idx) {
+            auto name = std::format("textures/set{:02}/texture{:05}.wal", idx % 50, idx);
+            name.resize(56, '\0');
+            index += name;
+            appendUint32(index, 12 + content.size());
+            appendUint32(index, 64 + (idx % 32) * 64);
+            content.append(64 + (idx % 32) * 64, static_cast<char>(idx));
+        }
+
+        std::string archive = "PACK";
+        appendUint32(archive, 12 + content.size());
+        appendUint32(archive, index.size());
+        return archive + content + index;
+    }
+
+    /**
+     * Open and close a reader over the archive repeatedly, loading its index and reading a few files each time.
+     *
+     * @param resource The resource to allocate the reader, its index, and the file names and content from.
+     * @param afterClose Called after each reader is destroyed.
+     * @return The mean time in nanoseconds for each open/read/close cycle.
+     */
+    template<class AfterClose>
+    double churn(std::ispanstream & stream, int iterations, std::pmr::memory_resource * resource, AfterClose afterClose)
+    {
+        std::size_t bytesRead = 0;
+        const auto start = Clock::now();
+
+        for (int iteration = 0; iteration < iterations; ++iteration) {
+            {
+                Reader reader(stream, resource);
+
+                for (int file = 0; file < FilesReadPerOpen; ++file) {
+                    const auto name = reader.fileName((iteration * 7919 + file * 104729) % reader.fileCount(), resource);
+                    bytesRead += reader.file(name).contents(resource).size();
+                }
+            }
+
+            afterClose();
+        }
+
+        const auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start);
+
+        if (0 == bytesRead) {
+            std::cerr << "No data read\n";
+        }
+
+        return elapsed.count() / iterations;
+    }
+}
+
+
+/**
+ * Measure the cost of opening, indexing, reading from and closing short-lived readers, with the index and content
+ * allocated from the global allocator, a monotonic arena that is released after each reader, and a pool.
+ *
+ * Usage: churn [iterations]
+ */
+int main(int argc, char ** argv)
+{
+    const int iterations = (1 < argc ? std::stoi(argv[1]) : 2000);
+    const auto archive = buildArchive();
+    std::ispanstream stream(std::span<const char>(archive.data(), archive.size()));
+
+    std::cout << std::format("Opening a {}-file archive {} times, reading {} files each time\n", FileCount, iterations, FilesReadPerOpen);
+
+    // warm up the stream and the caches
+    churn(stream, iterations / 10 + 1, std::pmr::new_delete_resource(), [] {});
+
+    const auto global = churn(stream, iterations, std::pmr::new_delete_resource(), [] {});
+    std::cout << std::format("  {: <22} {:>10.0f} ns/open\n", "global allocator", global);
+
+    std::vector<std::byte> buffer(4 * 1024 * 1024);
+    std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+    const auto monotonic = churn(stream, iterations, &arena, [&arena] { arena.release(); });
+    std::cout << std::format("  {: <22} {:>10.0f} ns/open ({:.2f}x)\n", "monotonic arena", monotonic, global / monotonic);
+
+    std::pmr::unsynchronized_pool_resource pool;
+    const auto pooled = churn(stream, iterations, &pool, [] {});
+    std::cout << std::format("  {: <22} {:>10.0f} ns/open ({:.2f}x)\n", "unsynchronised pool", pooled, global / pooled);
+
+    return 0;
+}
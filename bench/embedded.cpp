@@ -0,0 +1,90 @@
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../sdk/Reader"
+#include "sources.h"
+
+using Id::Pack::Reader;
+using Id::Pack::Embedded::sources;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    /** The number of times every file name is looked up. */
+    constexpr int Rounds = 20'000;
+
+    /**
+     * Look up every file name with a reader, Rounds times.
+     *
+     * @return The mean time in nanoseconds to look up each name.
+     */
+    template<class ReaderType>
+    double lookup(const ReaderType & reader, const std::vector<std::string> & names, long & checksum)
+    {
+        const auto start = Clock::now();
+
+        for (int round = 0; round < Rounds; ++round) {
+            for (const auto & name : names) {
+                checksum += (reader.has(name) ? reader.fileSize(name) : -1);
+            }
+        }
+
+        const auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start);
+        return elapsed.count() / static_cast<double>(Rounds * names.size());
+    }
+}
+
+
+/**
+ * Compare looking up the files in an archive embedded by idpak_embed() with looking them up in the same archive read from
+ * disk, after checking that both readers see the same files.
+ *
+ * Usage: embedded
+ */
+int main()
+{
+    const Reader reader(IDPAK_BENCH_EMBEDDED_ARCHIVE);
+
+    if (reader.fileCount() != sources.fileCount()) {
+        std::cerr << std::format("The embedded archive has {} files, the archive on disk has {}\n", sources.fileCount(), reader.fileCount());
+        return 1;
+    }
+
+    std::vector<std::string> names;
+
+    for (int idx = 0; idx < sources.fileCount(); ++idx) {
+        const std::string name(sources.fileName(idx));
+
+        if (!reader.has(name) || reader.fileIndex(name) != sources.fileIndex(name) || reader.file(idx).contents() != sources.file(idx).contents()) {
+            std::cerr << std::format("The embedded archive doesn't match the archive on disk for {}\n", name);
+            return 1;
+        }
+
+        names.push_back(name);
+        // one in two lookups is for a file that isn't in the archive
+        names.push_back(name + ".missing");
+    }
+
+    long readerChecksum = 0;
+    long embeddedChecksum = 0;
+
+    // warm up both indices
+    lookup(reader, names, readerChecksum);
+    lookup(sources, names, embeddedChecksum);
+
+    const auto fromDisk = lookup(reader, names, readerChecksum);
+    const auto embedded = lookup(sources, names, embeddedChecksum);
+
+    if (readerChecksum != embeddedChecksum) {
+        std::cerr << "Embedded lookups found different files\n";
+        return 1;
+    }
+
+    std::cout << std::format("Looking up {} names in an archive of {} files\n", names.size(), sources.fileCount());
+    std::cout << std::format("  {: <16} {:>8.1f} ns/name\n", "Reader", fromDisk);
+    std::cout << std::format("  {: <16} {:>8.1f} ns/name ({:.2f}x)\n", "EmbeddedReader", embedded, fromDisk / embedded);
+    return 0;
+}
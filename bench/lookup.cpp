@@ -0,0 +1,153 @@
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <random>
+#include <spanstream>
+#include <string>
+#include <vector>
+#include "../sdk/Reader"
+
+using Id::Pack::Reader;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    /** The number of names in each manifest resolved by the benchmark. */
+    constexpr int ManifestSize = 500;
+
+    /** Append a little-endian uint32 to a byte buffer. */
+    void appendUint32(std::string & out, std::uint32_t value)
+    {
+        for (int byte = 0; byte < 4; ++byte) {
+            out.push_back(static_cast<char>((value >> (8 * byte)) & 0xff));
+        }
+    }
+
+    /** The name of a file in the archives built by the benchmark. */
+    std::string fileName(int idx)
+    {
+        return std::format("textures/set{:03}/texture{:06}.wal", idx % 500, idx);
+    }
+
+    /** Build a PACK archive in memory, with one byte of content in each file. */
+    std::string buildArchive(int fileCount)
+    {
+        std::string content;
+        std::string index;
+
+        for (int idx = 0; idx < fileCount; ++idx) {
+            auto name = fileName(idx);
+            name.resize(56, '\0');
+            index += name;
+            appendUint32(index, 12 + content.size());
+            appendUint32(index, 1);
+            content.push_back(static_cast<char>(idx));
+        }
+
+        std::string archive = "PACK";
+        appendUint32(archive, 12 + content.size());
+        appendUint32(archive, index.size());
+        return archive + content + index;
+    }
+
+    /** Build manifests of random names, one in sixteen of which isn't in the archive. */
+    std::vector<std::vector<std::string>> buildManifests(int fileCount, int manifestCount)
+    {
+        std::mt19937 random(fileCount);
+        std::uniform_int_distribution<int> file(0, fileCount - 1);
+        std::vector<std::vector<std::string>> manifests(manifestCount);
+
+        for (auto & manifest : manifests) {
+            for (int name = 0; name < ManifestSize; ++name) {
+                manifest.push_back(0 == name % 16 ? fileName(fileCount + file(random)) : fileName(file(random)));
+            }
+        }
+
+        return manifests;
+    }
+
+    /**
+     * Resolve every manifest with one has() and fileIndex() call for each name.
+     *
+     * @return The mean time in nanoseconds to resolve each name.
+     */
+    double perName(const Reader & reader, const std::vector<std::vector<std::string>> & manifests, long & checksum)
+    {
+        const auto start = Clock::now();
+
+        for (const auto & manifest : manifests) {
+            for (const auto & name : manifest) {
+                checksum += (reader.has(name) ? reader.fileIndex(name) : -1);
+            }
+        }
+
+        const auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start);
+        return elapsed.count() / static_cast<double>(manifests.size() * ManifestSize);
+    }
+
+    /**
+     * Resolve every manifest with one fileIndices() call.
+     *
+     * @return The mean time in nanoseconds to resolve each name.
+     */
+    double batched(const Reader & reader, const std::vector<std::vector<std::string>> & manifests, long & checksum)
+    {
+        std::vector<std::string_view> names(ManifestSize);
+        std::vector<int> indices(ManifestSize);
+        const auto start = Clock::now();
+
+        for (const auto & manifest : manifests) {
+            std::ranges::copy(manifest, names.begin());
+            reader.fileIndices(names, indices);
+
+            for (const auto idx : indices) {
+                checksum += idx;
+            }
+        }
+
+        const auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start);
+        return elapsed.count() / static_cast<double>(manifests.size() * ManifestSize);
+    }
+}
+
+
+/**
+ * Measure the cost of resolving manifests of file names to file indices, one name at a time and in batches, in archives
+ * whose indices fit in the caches to varying degrees.
+ *
+ * Usage: lookup [manifests]
+ */
+int main(int argc, char ** argv)
+{
+    const int manifestCount = (1 < argc ? std::stoi(argv[1]) : 200);
+    std::cout << std::format("Resolving {} manifests of {} names\n", manifestCount, ManifestSize);
+
+    for (const auto fileCount : {2'000, 50'000, 1'000'000}) {
+        const auto archive = buildArchive(fileCount);
+        std::ispanstream stream(std::span<const char>(archive.data(), archive.size()));
+        const Reader reader(stream);
+        const auto manifests = buildManifests(fileCount, manifestCount);
+        long perNameChecksum = 0;
+        long batchedChecksum = 0;
+
+        // warm up the index
+        perName(reader, manifests, perNameChecksum);
+        batched(reader, manifests, batchedChecksum);
+
+        const auto single = perName(reader, manifests, perNameChecksum);
+        const auto batch = batched(reader, manifests, batchedChecksum);
+
+        if (perNameChecksum != batchedChecksum) {
+            std::cerr << "Batched lookups found different files\n";
+            return 1;
+        }
+
+        std::cout << std::format("  {:>8} files\n", fileCount);
+        std::cout << std::format("    {: <20} {:>8.1f} ns/name\n", "has() + fileIndex()", single);
+        std::cout << std::format("    {: <20} {:>8.1f} ns/name ({:.2f}x)\n", "fileIndices()", batch, single / batch);
+    }
+
+    return 0;
+}
@@ -0,0 +1,43 @@
+# Provides idpak_embed(), which compiles a PACK archive into a target.
+#
+#   idpak_embed(<target> <archive> [NAME <name>])
+#
+# The archive's content and its index are generated into a translation unit that is added to the target, along with a
+# header, <name>.h, that declares:
+#
+#   extern const Id::Pack::EmbeddedReader Id::Pack::Embedded::<name>;
+#
+# The index, including a perfect hash of the file names, is built by the compiler, so the reader is constant-initialised
+# and needs neither filesystem I/O nor index parsing at runtime. The name defaults to the archive's file name without
+# its extension. The archive is re-embedded whenever it changes. Embedding is intended for small archives - the whole
+# archive is compiled into the binary, and compile time grows with the number of files in its index.
+#
+# The target is linked to idpak with the plain target_link_libraries() signature, as the project's own targets are, so
+# any other libraries must be linked to the target with the plain signature too.
+
+function(idpak_embed target archive)
+    cmake_parse_arguments(PARSE_ARGV 2 IDPAK_EMBED "" "NAME" "")
+    get_filename_component(archive "${archive}" ABSOLUTE)
+
+    if (NOT IDPAK_EMBED_NAME)
+        get_filename_component(IDPAK_EMBED_NAME "${archive}" NAME_WE)
+    endif ()
+
+    set(generator "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/IdPakEmbedGenerate.cmake")
+    string(MAKE_C_IDENTIFIER "${IDPAK_EMBED_NAME}" name)
+    set(outputDir "${CMAKE_CURRENT_BINARY_DIR}/idpak_embed")
+    set(header "${outputDir}/${name}.h")
+    set(source "${outputDir}/${name}.cpp")
+
+    add_custom_command(
+            OUTPUT "${header}" "${source}"
+            COMMAND "${CMAKE_COMMAND}" "-DARCHIVE=${archive}" "-DNAME=${name}" "-DHEADER=${header}" "-DSOURCE=${source}" -P "${generator}"
+            DEPENDS "${archive}" "${generator}"
+            COMMENT "Embedding PACK archive ${archive} as ${name}"
+            VERBATIM
+    )
+
+    target_sources(${target} PRIVATE "${header}" "${source}")
+    target_include_directories(${target} PRIVATE "${outputDir}")
+    target_link_libraries(${target} idpak)
+endfunction()
@@ -0,0 +1,51 @@
+# Script-mode helper for idpak_embed() - generates the header and source that embed a PACK archive.
+#
+# Expects ARCHIVE, NAME, HEADER and SOURCE to be defined on the command line.
+
+foreach (variable ARCHIVE NAME HEADER SOURCE)
+    if (NOT DEFINED ${variable})
+        message(FATAL_ERROR "${variable} must be defined to embed a PACK archive")
+    endif ()
+endforeach ()
+
+file(READ "${ARCHIVE}" bytes HEX)
+
+if ("" STREQUAL "${bytes}")
+    message(FATAL_ERROR "PACK archive ${ARCHIVE} is empty")
+endif ()
+
+# 16 bytes per line, as character literals so that the data can be viewed as a std::string_view at compile time
+string(REGEX REPLACE "(................................)" "\\1\n        " bytes "${bytes}")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "'\\\\x\\1'," bytes "${bytes}")
+
+file(WRITE "${HEADER}" "// Generated by idpak_embed() from ${ARCHIVE} - do not edit.
+
+#ifndef IDPAK_EMBEDDED_${NAME}_H
+#define IDPAK_EMBEDDED_${NAME}_H
+
+#include <EmbeddedReader>
+
+namespace Id::Pack::Embedded
+{
+    extern const Id::Pack::EmbeddedReader ${NAME};
+}
+
+#endif
+")
+
+file(WRITE "${SOURCE}" "// Generated by idpak_embed() from ${ARCHIVE} - do not edit.
+
+#include \"${NAME}.h\"
+
+namespace
+{
+    constexpr char data[] = {
+        ${bytes}
+    };
+
+    constexpr std::string_view archive(data, sizeof(data));
+    constexpr auto index = Id::Pack::Embedded::buildIndex<Id::Pack::Embedded::entryCount(archive)>(archive);
+}
+
+constinit const Id::Pack::EmbeddedReader Id::Pack::Embedded::${NAME}(archive, index);
+")
@@ -0,0 +1,147 @@
+#include <bit>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "AccessTrace.h"
+
+using namespace Id::Pack;
+
+
+namespace
+{
+    /** The ID at the start of each segment of a trace file. */
+    constexpr std::string_view SegmentId = "IDTR";
+
+    /** The byte size of a segment's header. */
+    constexpr std::size_t SegmentHeaderSize = 20;
+
+    void appendUint32(std::string & out, std::uint32_t value)
+    {
+        if constexpr (std::endian::native != std::endian::little) {
+            value = std::byteswap(value);
+        }
+
+        out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    std::uint32_t readUint32(const char * bytes)
+    {
+        std::uint32_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+
+        if constexpr (std::endian::native != std::endian::little) {
+            value = std::byteswap(value);
+        }
+
+        return value;
+    }
+}
+
+
+AccessTrace::AccessTrace(std::string fileName, const TraceFingerprint & fingerprint)
+: m_fileName(std::move(fileName)),
+  m_fingerprint(fingerprint),
+  m_accessed(std::make_unique<std::atomic<bool>[]>(fingerprint.fileCount))
+{
+    m_order.reserve(fingerprint.fileCount);
+}
+
+
+void AccessTrace::record(int idx) noexcept
+{
+    // files added to the archive since the trace started aren't part of the archive it was recorded against
+    if (0 > idx || m_fingerprint.fileCount <= static_cast<std::uint32_t>(idx)) {
+        return;
+    }
+
+    if (m_accessed[idx].exchange(true, std::memory_order_relaxed)) {
+        return;
+    }
+
+    // the order has capacity for every file, so this never allocates
+    std::lock_guard lock(m_mutex);
+    m_order.push_back(static_cast<std::uint32_t>(idx));
+}
+
+
+void AccessTrace::write() const
+{
+    std::string segment(SegmentId);
+
+    {
+        std::lock_guard lock(m_mutex);
+        segment.reserve(SegmentHeaderSize + 4 * m_order.size());
+        appendUint32(segment, m_fingerprint.fileCount);
+        appendUint32(segment, m_fingerprint.indexOffset);
+        appendUint32(segment, m_fingerprint.indexSize);
+        appendUint32(segment, static_cast<std::uint32_t>(m_order.size()));
+
+        for (const auto idx : m_order) {
+            appendUint32(segment, idx);
+        }
+    }
+
+    auto out = std::ofstream(m_fileName, std::ios::binary | std::ios::app);
+    out.write(segment.data(), static_cast<std::streamsize>(segment.size()));
+    out.close();
+
+    if (out.fail()) {
+        throw std::runtime_error(std::format(R"(Error writing trace file "{}")", m_fileName));
+    }
+}
+
+
+std::vector<int> AccessTrace::read(const std::string & fileName, const TraceFingerprint & fingerprint)
+{
+    auto in = std::ifstream(fileName, std::ios::binary);
+
+    if (!in) {
+        throw std::runtime_error(std::format(R"(Error opening trace file "{}")", fileName));
+    }
+
+    std::ostringstream content;
+    content << in.rdbuf();
+
+    if (in.bad()) {
+        throw std::runtime_error(std::format(R"(Error reading trace file "{}")", fileName));
+    }
+
+    auto bytes = content.view();
+    std::vector<bool> seen(fingerprint.fileCount);
+    std::vector<int> order;
+
+    while (!bytes.empty()) {
+        if (SegmentHeaderSize > bytes.size() || !bytes.starts_with(SegmentId)) {
+            throw std::runtime_error(std::format(R"(Trace file "{}" is malformed)", fileName));
+        }
+
+        const TraceFingerprint recorded = {readUint32(bytes.data() + 4), readUint32(bytes.data() + 8), readUint32(bytes.data() + 12)};
+        const auto count = readUint32(bytes.data() + 16);
+        bytes.remove_prefix(SegmentHeaderSize);
+
+        if (recorded != fingerprint) {
+            throw std::runtime_error(std::format(R"(Trace file "{}" was recorded against a different archive)", fileName));
+        }
+
+        if (bytes.size() / 4 < count) {
+            throw std::runtime_error(std::format(R"(Trace file "{}" is truncated)", fileName));
+        }
+
+        for (std::uint32_t entry = 0; entry < count; ++entry, bytes.remove_prefix(4)) {
+            const auto idx = readUint32(bytes.data());
+
+            if (fingerprint.fileCount <= idx) {
+                throw std::runtime_error(std::format(R"(Trace file "{}" is malformed)", fileName));
+            }
+
+            if (!seen[idx]) {
+                seen[idx] = true;
+                order.push_back(static_cast<int>(idx));
+            }
+        }
+    }
+
+    return order;
+}
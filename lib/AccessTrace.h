@@ -0,0 +1,99 @@
+#ifndef LIBIDPAK_ACCESSTRACE_H
+#define LIBIDPAK_ACCESSTRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Id::Pack
+{
+    /**
+     * Identifies the archive a trace was recorded against, so that a trace isn't applied to a different archive whose
+     * file indices mean something else.
+     */
+    struct TraceFingerprint
+    {
+        std::uint32_t fileCount;
+        std::uint32_t indexOffset;
+        std::uint32_t indexSize;
+
+        bool operator==(const TraceFingerprint &) const noexcept = default;
+    };
+
+    /**
+     * Records the order in which the files in an archive are first accessed.
+     *
+     * A trace file is a sequence of segments, one appended each time a trace is written, so a single file can collect
+     * the accesses of several runs. Each segment is the ID "IDTR", the uint32 file count, index offset and index size
+     * of the archive, the uint32 number of files recorded and the uint32 index of each file in the order it was first
+     * accessed. All integers are little-endian.
+     */
+    class AccessTrace
+    {
+    public:
+        /**
+         * @param fileName The trace file to which to append the trace when it's written.
+         * @param fingerprint The fingerprint of the archive whose accesses are recorded.
+         */
+        AccessTrace(std::string fileName, const TraceFingerprint & fingerprint);
+
+        // AccessTrace instances can't be copied or moved
+        AccessTrace(const AccessTrace &) = delete;
+        AccessTrace(AccessTrace &&) = delete;
+        void operator = (const AccessTrace &) = delete;
+        void operator = (AccessTrace &&) = delete;
+
+        /**
+         * Record an access to a file. Only the first access to each file is recorded.
+         *
+         * This is safe to call from several threads at once. Once a file has been recorded, recording it again costs one
+         * atomic exchange.
+         *
+         * @param idx The 0-based index of the file. Files outside the fingerprinted archive (for example, those appended to
+         * it since a reader reloaded it) aren't recorded.
+         */
+        void record(int idx) noexcept;
+
+        /**
+         * Append the trace to the trace file.
+         *
+         * @throws std::runtime_error if the trace file can't be written.
+         */
+        void write() const;
+
+        /**
+         * Read the order in which files were first accessed from a trace file.
+         *
+         * Where the file holds more than one segment, a file's position is that of its first access in the earliest
+         * segment that records it.
+         *
+         * @param fileName The trace file to read.
+         * @param fingerprint The fingerprint of the archive the trace is to be applied to.
+         * @return The indices of the files accessed, in first-access order.
+         * @throws std::runtime_error if the trace file can't be read, is malformed, or was recorded against an archive
+         * with a different fingerprint.
+         */
+        static std::vector<int> read(const std::string & fileName, const TraceFingerprint & fingerprint);
+
+    private:
+        /** The trace file. */
+        std::string m_fileName;
+
+        /** The fingerprint of the archive whose accesses are recorded. */
+        TraceFingerprint m_fingerprint;
+
+        /** Whether each file has been accessed. */
+        std::unique_ptr<std::atomic<bool>[]> m_accessed;
+
+        /** Guards the order of accesses. */
+        mutable std::mutex m_mutex;
+
+        /** The indices of the files accessed, in first-access order. */
+        std::vector<std::uint32_t> m_order;
+    };
+}
+
+#endif
@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+#include "Codecs.h"
+
+#if defined(IDPAK_WITH_ZLIB)
+#include <zlib.h>
+#endif
+
+#if defined(IDPAK_WITH_ZSTD)
+#include <zstd.h>
+#endif
+
+using namespace Id::Pack;
+
+
+namespace
+{
+    /**
+     * The built-in LZ-class codec from Daikatana's PACK archives.
+     *
+     * The compressed data is a sequence of runs, each introduced by a control byte x:
+     * - x < 64: x + 1 literal bytes follow
+     * - x < 128: x - 62 zero bytes
+     * - x < 192: the following byte, repeated x - 126 times
+     * - x < 254: x - 190 bytes copied from the output, starting the following byte + 2 bytes before the current end
+     * - x == 255: end of data
+     */
+    namespace Daikatana
+    {
+        constexpr std::size_t MaxLiterals = 64;
+        constexpr std::size_t MinRun = 2;
+        constexpr std::size_t MaxRun = 65;
+        constexpr std::size_t MinCopy = 3;
+        constexpr std::size_t MaxCopy = 63;
+        constexpr std::size_t MinDistance = 2;
+        constexpr std::size_t MaxDistance = 257;
+
+        std::string compress(std::string_view in)
+        {
+            std::string out;
+            out.reserve(in.size() + in.size() / MaxLiterals + 2);
+            std::size_t pos = 0;
+            std::size_t literals = 0;
+
+            const auto flushLiterals = [&]() {
+                if (0 < literals) {
+                    out.push_back(static_cast<char>(literals - 1));
+                    out.append(in.substr(pos - literals, literals));
+                    literals = 0;
+                }
+            };
+
+            while (pos < in.size()) {
+                const auto maxRun = std::min(MaxRun, in.size() - pos);
+                std::size_t run = 1;
+
+                while (run < maxRun && in[pos + run] == in[pos]) {
+                    ++run;
+                }
+
+                // find the longest copy from the window of output before the current position
+                std::size_t copy = 0;
+                std::size_t copyDistance = 0;
+                const auto maxCopy = std::min(MaxCopy, in.size() - pos);
+
+                for (auto distance = MinDistance; distance <= std::min(MaxDistance, pos) && copy < maxCopy; ++distance) {
+                    std::size_t length = 0;
+
+                    while (length < maxCopy && in[pos - distance + length] == in[pos + length]) {
+                        ++length;
+                    }
+
+                    if (length > copy) {
+                        copy = length;
+                        copyDistance = distance;
+                    }
+                }
+
+                if (MinCopy <= copy && copy > run) {
+                    flushLiterals();
+                    out.push_back(static_cast<char>(190 + copy));
+                    out.push_back(static_cast<char>(copyDistance - MinDistance));
+                    pos += copy;
+                } else if (MinRun <= run) {
+                    flushLiterals();
+
+                    if ('\0' == in[pos]) {
+                        out.push_back(static_cast<char>(62 + run));
+                    } else {
+                        out.push_back(static_cast<char>(126 + run));
+                        out.push_back(in[pos]);
+                    }
+
+                    pos += run;
+                } else {
+                    ++literals;
+                    ++pos;
+
+                    if (MaxLiterals == literals) {
+                        flushLiterals();
+                    }
+                }
+            }
+
+            flushLiterals();
+            out.push_back(static_cast<char>(255));
+            return out;
+        }
+
+        std::string decompress(std::string_view in, std::size_t size)
+        {
+            std::string out;
+            out.reserve(size);
+            std::size_t pos = 0;
+
+            const auto next = [&in, &pos]() -> unsigned char {
+                if (pos >= in.size()) {
+                    throw std::runtime_error("Compressed data is truncated");
+                }
+
+                return static_cast<unsigned char>(in[pos++]);
+            };
+
+            while (pos < in.size()) {
+                const auto control = next();
+
+                if (64 > control) {
+                    const std::size_t length = control + 1;
+
+                    if (length > in.size() - pos) {
+                        throw std::runtime_error("Compressed data is truncated");
+                    }
+
+                    out.append(in.substr(pos, length));
+                    pos += length;
+                } else if (128 > control) {
+                    out.append(control - 62, '\0');
+                } else if (192 > control) {
+                    out.append(control - 126, static_cast<char>(next()));
+                } else if (254 > control) {
+                    const std::size_t distance = next() + MinDistance;
+
+                    if (distance > out.size()) {
+                        throw std::runtime_error("Compressed data refers to data before the start of the file");
+                    }
+
+                    // the source and destination can overlap, so this must be done byte by byte
+                    for (auto length = control - 190; 0 < length; --length) {
+                        out.push_back(out[out.size() - distance]);
+                    }
+                } else if (255 == control) {
+                    break;
+                } else {
+                    throw std::runtime_error("Compressed data is not valid");
+                }
+            }
+
+            if (out.size() != size) {
+                throw std::runtime_error("Decompressed data is not the expected size");
+            }
+
+            return out;
+        }
+    }
+
+    [[noreturn]] void unavailable(Codec codec)
+    {
+        throw std::runtime_error(std::format("The {} codec is not available in this build", codecName(codec)));
+    }
+}
+
+
+bool Id::Pack::isAvailable(Codec codec) noexcept
+{
+    switch (codec) {
+        case Codec::None:
+        case Codec::Daikatana:
+            return true;
+
+        case Codec::Zlib:
+#if defined(IDPAK_WITH_ZLIB)
+            return true;
+#else
+            return false;
+#endif
+
+        case Codec::Zstd:
+#if defined(IDPAK_WITH_ZSTD)
+            return true;
+#else
+            return false;
+#endif
+    }
+
+    return false;
+}
+
+
+std::string_view Id::Pack::codecName(Codec codec) noexcept
+{
+    switch (codec) {
+        case Codec::None:
+            return "none";
+
+        case Codec::Daikatana:
+            return "daikatana";
+
+        case Codec::Zlib:
+            return "zlib";
+
+        case Codec::Zstd:
+            return "zstd";
+    }
+
+    return "unknown";
+}
+
+
+std::string Id::Pack::compress(Codec codec, std::string_view data)
+{
+    switch (codec) {
+        case Codec::None:
+            return std::string(data);
+
+        case Codec::Daikatana:
+            return Daikatana::compress(data);
+
+        case Codec::Zlib: {
+#if defined(IDPAK_WITH_ZLIB)
+            auto size = compressBound(data.size());
+            std::string out(size, 0);
+
+            if (Z_OK != compress2(reinterpret_cast<Bytef *>(out.data()), &size, reinterpret_cast<const Bytef *>(data.data()), data.size(), Z_BEST_COMPRESSION)) {
+                throw std::runtime_error("zlib compression failed");
+            }
+
+            out.resize(size);
+            return out;
+#else
+            unavailable(codec);
+#endif
+        }
+
+        case Codec::Zstd: {
+#if defined(IDPAK_WITH_ZSTD)
+            std::string out(ZSTD_compressBound(data.size()), 0);
+            const auto size = ZSTD_compress(out.data(), out.size(), data.data(), data.size(), 19);
+
+            if (ZSTD_isError(size)) {
+                throw std::runtime_error(std::format("zstd compression failed: {}", ZSTD_getErrorName(size)));
+            }
+
+            out.resize(size);
+            return out;
+#else
+            unavailable(codec);
+#endif
+        }
+    }
+
+    throw std::runtime_error(std::format("Unrecognised codec {}", static_cast<int>(codec)));
+}
+
+
+std::string Id::Pack::decompress(Codec codec, std::string_view data, std::size_t size)
+{
+    switch (codec) {
+        case Codec::None:
+            if (data.size() != size) {
+                throw std::runtime_error("Data is not the expected size");
+            }
+
+            return std::string(data);
+
+        case Codec::Daikatana:
+            return Daikatana::decompress(data, size);
+
+        case Codec::Zlib: {
+#if defined(IDPAK_WITH_ZLIB)
+            std::string out(size, 0);
+            auto outSize = static_cast<uLongf>(size);
+
+            if (Z_OK != uncompress(reinterpret_cast<Bytef *>(out.data()), &outSize, reinterpret_cast<const Bytef *>(data.data()), data.size()) || outSize != size) {
+                throw std::runtime_error("zlib compressed data is not valid");
+            }
+
+            return out;
+#else
+            unavailable(codec);
+#endif
+        }
+
+        case Codec::Zstd: {
+#if defined(IDPAK_WITH_ZSTD)
+            std::string out(size, 0);
+            const auto outSize = ZSTD_decompress(out.data(), out.size(), data.data(), data.size());
+
+            if (ZSTD_isError(outSize) || outSize != size) {
+                throw std::runtime_error("zstd compressed data is not valid");
+            }
+
+            return out;
+#else
+            unavailable(codec);
+#endif
+        }
+    }
+
+    throw std::runtime_error(std::format("Unrecognised codec {}", static_cast<int>(codec)));
+}
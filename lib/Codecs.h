@@ -0,0 +1,58 @@
+#ifndef LIBIDPAK_CODECS_H
+#define LIBIDPAK_CODECS_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Id::Pack
+{
+    /**
+     * The compression codecs with which files can be stored in archives.
+     *
+     * The values are those stored in the index of extended (PAKX) archives.
+     */
+    enum class Codec
+    : std::uint8_t {
+        None = 0,
+        Daikatana = 1,
+        Zlib = 2,
+        Zstd = 3,
+    };
+
+    /**
+     * Check whether a codec is available in this build of the library.
+     *
+     * The built-in codecs (None and Daikatana) are always available; Zlib and Zstd are available if the library was
+     * built with them.
+     */
+    bool isAvailable(Codec codec) noexcept;
+
+    /** @return A human-readable name for a codec. */
+    std::string_view codecName(Codec codec) noexcept;
+
+    /**
+     * Compress some data.
+     *
+     * @param codec The codec to compress with.
+     * @param data The data to compress.
+     *
+     * @return The compressed data.
+     * @throws std::runtime_error if the codec is not available or the data can't be compressed.
+     */
+    std::string compress(Codec codec, std::string_view data);
+
+    /**
+     * Decompress some data.
+     *
+     * @param codec The codec the data is compressed with.
+     * @param data The compressed data.
+     * @param size The expected size of the decompressed data.
+     *
+     * @return The decompressed data.
+     * @throws std::runtime_error if the codec is not available or the data is not valid.
+     */
+    std::string decompress(Codec codec, std::string_view data, std::size_t size);
+}
+
+#endif
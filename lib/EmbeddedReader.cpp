@@ -0,0 +1,37 @@
+#include <fstream>
+#include "EmbeddedReader.h"
+
+using namespace Id::Pack;
+
+
+std::ostream & Id::Pack::operator<<(std::ostream & out, const EmbeddedReader::File & file) noexcept
+{
+    out << file.contents();
+    return out;
+}
+
+
+void EmbeddedReader::extract(int idx, std::ostream & out) const
+{
+    out << file(idx);
+}
+
+
+void EmbeddedReader::extract(std::string_view fileName, std::ostream & out) const
+{
+    out << file(fileName);
+}
+
+
+void EmbeddedReader::extract(int idx, const std::string & outputFile) const
+{
+    auto out = std::ofstream(outputFile, std::ios::binary);
+    extract(idx, out);
+}
+
+
+void EmbeddedReader::extract(std::string_view fileName, const std::string & outputFile) const
+{
+    auto out = std::ofstream(outputFile, std::ios::binary);
+    extract(fileName, out);
+}
@@ -0,0 +1,598 @@
+#ifndef LIBIDPAK_EMBEDDEDREADER_H
+#define LIBIDPAK_EMBEDDEDREADER_H
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace Id::Pack
+{
+    /**
+     * Support for archives that are compiled into the binary using the idpak_embed() CMake function.
+     *
+     * The content of this namespace is used by the generated code to build the index at compile time - client code
+     * should only need EmbeddedReader.
+     */
+    namespace Embedded
+    {
+        /** The byte size of the header of a PACK archive. */
+        inline constexpr std::size_t HeaderSize = 12;
+
+        /** The byte size of each entry in the index of a PACK archive. */
+        inline constexpr std::size_t EntrySize = 64;
+
+        /** The maximum byte length of a file name in the index of a PACK archive. */
+        inline constexpr std::size_t NameLength = 56;
+
+        /** Marker for a slot in the perfect hash table that no file name hashes to. */
+        inline constexpr std::uint32_t EmptySlot = 0xffffffff;
+
+        /** An entry in the index of an embedded PACK archive. */
+        struct IndexEntry
+        {
+            std::string_view fileName;
+            std::uint32_t fileOffset;
+            std::uint32_t fileSize;
+        };
+
+        /**
+         * The compile-time index of an embedded PACK archive containing N files.
+         *
+         * Name lookups use a perfect hash (hash and displace): half of a name's hash selects a bucket, and the other
+         * half, mixed with the bucket's seed, selects a slot that holds the index of the only file that can have that
+         * name.
+         */
+        template<std::size_t N>
+        struct Index
+        {
+            std::array<IndexEntry, N> entries;
+            std::array<std::uint32_t, N> seeds;
+            std::array<std::uint32_t, N> slots;
+        };
+
+        /** Hash a file name (64-bit FNV-1a). */
+        constexpr std::uint64_t hash(std::string_view fileName) noexcept
+        {
+            std::uint64_t hash = 14695981039346656037ull;
+
+            for (const auto ch : fileName) {
+                hash ^= static_cast<std::uint8_t>(ch);
+                hash *= 1099511628211ull;
+            }
+
+            return hash;
+        }
+
+        /**
+         * Mix a seed into half of a file name hash.
+         *
+         * This is the murmur3 finaliser, so that consecutive seeds produce unrelated results. Keeping it separate from
+         * hash() means the perfect hash can be built trying many seeds without rehashing the names.
+         */
+        constexpr std::uint32_t mix(std::uint32_t hash, std::uint32_t seed) noexcept
+        {
+            hash ^= seed * 0x9e3779b9u;
+            hash ^= hash >> 16;
+            hash *= 0x85ebca6bu;
+            hash ^= hash >> 13;
+            hash *= 0xc2b2ae35u;
+            hash ^= hash >> 16;
+            return hash;
+        }
+
+        /** The perfect hash bucket, of N, for a file name hash. */
+        constexpr std::size_t bucket(std::uint64_t hash, std::size_t n) noexcept
+        {
+            return mix(static_cast<std::uint32_t>(hash), 0) % n;
+        }
+
+        /** The perfect hash slot, of N, for a file name hash using a given bucket seed. */
+        constexpr std::size_t slot(std::uint64_t hash, std::uint32_t seed, std::size_t n) noexcept
+        {
+            return mix(static_cast<std::uint32_t>(hash >> 32), seed) % n;
+        }
+
+        /** Read a little-endian uint32 from a given byte offset in some data. */
+        constexpr std::uint32_t readUint32(std::string_view data, std::size_t offset) noexcept
+        {
+            assert(offset + 4 <= data.size());
+            std::uint32_t value = 0;
+
+            for (std::size_t byte = 4; byte > 0; --byte) {
+                value = (value << 8) | static_cast<std::uint8_t>(data[offset + byte - 1]);
+            }
+
+            return value;
+        }
+
+        /**
+         * Validate the header of an embedded PACK archive and determine how many files it contains.
+         *
+         * @throws std::invalid_argument if the archive is not valid. In a constant expression this is a compile error.
+         */
+        constexpr std::size_t entryCount(std::string_view archive)
+        {
+            if (HeaderSize > archive.size() || "PACK" != archive.substr(0, 4)) {
+                throw std::invalid_argument("Embedded archive is not a PACK archive");
+            }
+
+            const std::size_t indexOffset = readUint32(archive, 4);
+            const std::size_t indexSize = readUint32(archive, 8);
+
+            if (0 != indexSize % EntrySize || indexOffset + indexSize > archive.size()) {
+                throw std::invalid_argument("Embedded archive index is not valid");
+            }
+
+            return indexSize / EntrySize;
+        }
+
+        /**
+         * Parse the index of an embedded PACK archive and build its perfect hash.
+         *
+         * This is intended to be evaluated by the compiler, so it favours simplicity over speed. As with Reader, when
+         * the archive contains more than one file with the same name, lookups by name find the last of them.
+         *
+         * @throws std::invalid_argument if the archive is not valid. In a constant expression this is a compile error.
+         * @throws std::logic_error if the perfect hash can't be built. In a constant expression this is a compile error.
+         */
+        template<std::size_t N>
+        constexpr Index<N> buildIndex(std::string_view archive)
+        {
+            Index<N> index{};
+            const std::size_t indexOffset = readUint32(archive, 4);
+
+            for (std::size_t idx = 0; idx < N; ++idx) {
+                const auto entry = archive.substr(indexOffset + idx * EntrySize, EntrySize);
+                const auto name = entry.substr(0, NameLength);
+                index.entries[idx] = {name.substr(0, name.find('\0')), readUint32(entry, 56), readUint32(entry, 60)};
+
+                if (static_cast<std::size_t>(index.entries[idx].fileOffset) + index.entries[idx].fileSize > archive.size()) {
+                    throw std::invalid_argument("Embedded archive contains a file that extends beyond the end of the archive");
+                }
+            }
+
+            if constexpr (0 < N) {
+                // group the files by bucket, keeping them in index order within each bucket
+                std::array<std::uint64_t, N> hashes{};
+                std::array<std::uint32_t, N> bucket{};
+                std::array<std::uint32_t, N + 1> bucketStart{};
+
+                for (std::size_t idx = 0; idx < N; ++idx) {
+                    hashes[idx] = hash(index.entries[idx].fileName);
+                    bucket[idx] = Embedded::bucket(hashes[idx], N);
+                    ++bucketStart[bucket[idx] + 1];
+                }
+
+                std::partial_sum(bucketStart.begin(), bucketStart.end(), bucketStart.begin());
+                std::array<std::uint32_t, N> members{};
+                std::array<std::uint32_t, N> bucketSize{};
+
+                for (std::uint32_t idx = 0; idx < N; ++idx) {
+                    members[bucketStart[bucket[idx]] + bucketSize[bucket[idx]]] = idx;
+                    ++bucketSize[bucket[idx]];
+                }
+
+                // files with the same name share a bucket - drop all but the last of them from the hash
+                for (std::size_t current = 0; current < N; ++current) {
+                    const auto first = members.begin() + bucketStart[current];
+                    const auto last = std::remove_if(first, first + bucketSize[current], [&](std::uint32_t member) {
+                        return std::any_of(first, first + bucketSize[current], [&](std::uint32_t other) {
+                            return other > member && index.entries[other].fileName == index.entries[member].fileName;
+                        });
+                    });
+
+                    bucketSize[current] = static_cast<std::uint32_t>(last - first);
+                }
+
+                // place the largest buckets first, while the table has the most free slots
+                std::array<std::uint32_t, N> order{};
+                std::iota(order.begin(), order.end(), 0);
+                std::ranges::sort(order, [&bucketSize](auto lhs, auto rhs) {
+                    return bucketSize[lhs] > bucketSize[rhs];
+                });
+
+                index.slots.fill(EmptySlot);
+                std::array<std::uint32_t, N> candidates{};
+
+                for (const auto current : order) {
+                    if (0 == bucketSize[current]) {
+                        break;
+                    }
+
+                    const auto first = members.begin() + bucketStart[current];
+
+                    for (std::uint32_t seed = 1;; ++seed) {
+                        if (16 * N + 64 < seed) {
+                            throw std::logic_error("Could not build a perfect hash for the embedded archive index");
+                        }
+
+                        bool placed = true;
+
+                        for (std::size_t member = 0; member < bucketSize[current] && placed; ++member) {
+                            candidates[member] = slot(hashes[first[member]], seed, N);
+                            placed = EmptySlot == index.slots[candidates[member]]
+                                && std::find(candidates.begin(), candidates.begin() + member, candidates[member]) == candidates.begin() + member;
+                        }
+
+                        if (placed) {
+                            for (std::size_t member = 0; member < bucketSize[current]; ++member) {
+                                index.slots[candidates[member]] = first[member];
+                            }
+
+                            index.seeds[current] = seed;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            return index;
+        }
+    }
+
+    /**
+     * Read-only view of a PACK archive embedded in the binary by the idpak_embed() CMake function.
+     *
+     * The index is parsed and hashed by the compiler, so instances are constant-initialised and lookups do no parsing
+     * and no I/O. The API mirrors Reader, except that content is returned as views of the embedded data rather than as
+     * copies.
+     */
+    class EmbeddedReader
+    {
+    public:
+        /**
+         * A view of the portion of the embedded archive that contains a single file.
+         */
+        class File
+        {
+        // the reader is a friend so that it can construct File instances
+        friend class EmbeddedReader;
+
+        public:
+            /** @return The size, in bytes, of the file. */
+            constexpr int size() const noexcept
+            {
+                return static_cast<int>(m_data.size());
+            }
+
+            /** @return The offset from the start of the file from which the next byte will be read. */
+            constexpr int pos() const noexcept
+            {
+                return static_cast<int>(m_readPos);
+            }
+
+            /** @return Whether random access reading has progressed beyond the end of the file. */
+            constexpr bool eof() const noexcept
+            {
+                return m_readPos >= m_data.size();
+            }
+
+            /** Reset the read position to the start of the file. */
+            constexpr void reset() noexcept
+            {
+                m_readPos = 0;
+            }
+
+            /** Seek to a given byte offset in the file. */
+            constexpr void seek(int pos) noexcept
+            {
+                assert(0 <= pos && pos < size());
+                m_readPos = static_cast<std::size_t>(pos);
+            }
+
+            /**
+             * Read a number of bytes from the file, starting at the current read position.
+             *
+             * @throws std::runtime_error if there are fewer than the requested number of bytes left to read.
+             */
+            constexpr std::string_view read(int bytes)
+            {
+                if (0 > bytes || static_cast<std::size_t>(bytes) > m_data.size() - std::min(m_readPos, m_data.size())) {
+                    throw std::runtime_error("Error reading data for file");
+                }
+
+                const auto ret = m_data.substr(m_readPos, static_cast<std::size_t>(bytes));
+                m_readPos += ret.size();
+                return ret;
+            }
+
+            /**
+             * Fetch all the content of the file.
+             *
+             * The current read position is unaffected by this call.
+             */
+            constexpr std::string_view contents() const noexcept
+            {
+                return m_data;
+            }
+
+            /** Copy the full, unmodified content of the file to a string. */
+            explicit operator std::string() const noexcept
+            {
+                return std::string(m_data);
+            }
+
+        private:
+            // there's no public constructor, only EmbeddedReader objects can instantiate Files
+            explicit constexpr File(std::string_view data) noexcept
+            : m_data(data)
+            {}
+
+            /** The portion of the embedded archive that contains the file. */
+            std::string_view m_data;
+
+            /** For random access, the current read position. */
+            std::size_t m_readPos = 0;
+        };
+
+        /**
+         * An iterator class so that the files in an embedded archive can be iterated using STL algorithms and range-for
+         * loops.
+         */
+        class Iterator final
+        {
+        // the reader is a friend so that it can construct Iterator instances
+        friend class EmbeddedReader;
+
+        public:
+            /** Pre-increment the iterator to the next file. */
+            constexpr Iterator & operator++() noexcept
+            {
+                if (m_index < m_reader->fileCount()) {
+                    ++m_index;
+                }
+
+                return *this;
+            }
+
+            /** Post-increment the iterator to the next file. */
+            constexpr Iterator operator++(int) noexcept
+            {
+                Iterator ret(*this);
+                ++*this;
+                return ret;
+            }
+
+            /** Dereference the iterator to retrieve the File it points to. */
+            constexpr File operator*() const noexcept
+            {
+                return m_reader->file(m_index);
+            }
+
+            /**
+             * Check for equality between two iterators.
+             *
+             * Two iterators are equal if they reference the same underlying reader and point to the same file.
+             */
+            constexpr bool operator==(const Iterator & other) const noexcept
+            {
+                return other.m_reader == m_reader && other.m_index == m_index;
+            }
+
+        private:
+            constexpr Iterator(const EmbeddedReader & reader, int index) noexcept
+            : m_reader(&reader),
+              m_index(index)
+            {}
+
+            /** The reader whose files are being iterated. */
+            const EmbeddedReader * m_reader;
+
+            /** The 0-based index of the file the iterator points to. */
+            int m_index;
+        };
+
+        /**
+         * Initialise a reader for an embedded archive.
+         *
+         * This is called by the code generated by idpak_embed(). The archive and index must outlive the reader.
+         *
+         * @param archive The content of the PACK archive.
+         * @param index The index built by Embedded::buildIndex() from the archive.
+         */
+        template<std::size_t N>
+        constexpr EmbeddedReader(std::string_view archive, const Embedded::Index<N> & index) noexcept
+        : m_archive(archive),
+          m_entries(index.entries),
+          m_seeds(index.seeds),
+          m_slots(index.slots)
+        {}
+
+        // embedded readers are views of static data, and are only ever referred to
+        EmbeddedReader(const EmbeddedReader &) = delete;
+        EmbeddedReader(EmbeddedReader &&) = delete;
+        void operator = (const EmbeddedReader &) = delete;
+        void operator = (EmbeddedReader &&) = delete;
+
+        /** @return The number of files in the embedded archive. */
+        constexpr int fileCount() const noexcept
+        {
+            return static_cast<int>(m_entries.size());
+        }
+
+        /**
+         * Check whether a named file exists in the archive.
+         *
+         * The name matching is as strict as Reader::has().
+         *
+         * @param fileName The name of the file to look for.
+         */
+        constexpr bool has(std::string_view fileName) const noexcept
+        {
+            return 0 <= find(fileName);
+        }
+
+        /**
+         * Look up the name of a file from its position in the archive.
+         *
+         * The provided index must be >= 0 and < fileCount().
+         */
+        constexpr std::string_view fileName(int idx) const noexcept
+        {
+            return entry(idx).fileName;
+        }
+
+        /**
+         * Look up the index of a named file in the archive.
+         *
+         * The provided file name must be in the archive, as determined by has().
+         */
+        constexpr int fileIndex(std::string_view fileName) const noexcept
+        {
+            const auto idx = find(fileName);
+            assert(0 <= idx);
+            return idx;
+        }
+
+        /**
+         * Look up the byte offset of a file in the archive.
+         *
+         * The provided index must be >= 0 and < fileCount().
+         */
+        constexpr int fileOffset(int idx) const noexcept
+        {
+            return static_cast<int>(entry(idx).fileOffset);
+        }
+
+        /**
+         * Look up the byte offset of a file in the archive.
+         *
+         * The provided file name must be in the archive, as determined by has().
+         */
+        constexpr int fileOffset(std::string_view fileName) const noexcept
+        {
+            return fileOffset(fileIndex(fileName));
+        }
+
+        /**
+         * Look up the byte size of a file in the archive.
+         *
+         * The provided index must be >= 0 and < fileCount().
+         */
+        constexpr int fileSize(int idx) const noexcept
+        {
+            return static_cast<int>(entry(idx).fileSize);
+        }
+
+        /**
+         * Look up the byte size of a file in the archive.
+         *
+         * The provided file name must be in the archive, as determined by has().
+         */
+        constexpr int fileSize(std::string_view fileName) const noexcept
+        {
+            return fileSize(fileIndex(fileName));
+        }
+
+        /**
+         * Get a file from the archive.
+         *
+         * The provided index must be >= 0 and < fileCount().
+         */
+        constexpr File file(int idx) const noexcept
+        {
+            const auto & indexEntry = entry(idx);
+            return File(m_archive.substr(indexEntry.fileOffset, indexEntry.fileSize));
+        }
+
+        /**
+         * Get a file from the archive.
+         *
+         * The provided file name must be in the archive, as determined by has().
+         */
+        constexpr File file(std::string_view fileName) const noexcept
+        {
+            return file(fileIndex(fileName));
+        }
+
+        /**
+         * Extract a file from the archive to a file in the local filesystem.
+         *
+         * The provided index must be >= 0 and < fileCount().
+         */
+        void extract(int idx, const std::string & outputFile) const;
+
+        /**
+         * Extract a file from the archive to a file in the local filesystem.
+         *
+         * The provided file name must be in the archive, as determined by has().
+         */
+        void extract(std::string_view fileName, const std::string & outputFile) const;
+
+        /**
+         * Extract a file from the archive and write its content to a stream.
+         *
+         * The provided index must be >= 0 and < fileCount().
+         */
+        void extract(int idx, std::ostream & out) const;
+
+        /**
+         * Extract a file from the archive and write its content to a stream.
+         *
+         * The provided file name must be in the archive, as determined by has().
+         */
+        void extract(std::string_view fileName, std::ostream & out) const;
+
+        /** @return an Iterator pointing to the first file in the archive. */
+        constexpr Iterator begin() const noexcept
+        {
+            return {*this, 0};
+        }
+
+        /** @return an Iterator pointing past the last file in the archive. */
+        constexpr Iterator end() const noexcept
+        {
+            return {*this, fileCount()};
+        }
+
+    private:
+        /** Fetch the index entry for a file. */
+        constexpr const Embedded::IndexEntry & entry(int idx) const noexcept
+        {
+            assert(0 <= idx && fileCount() > idx);
+            return m_entries[static_cast<std::size_t>(idx)];
+        }
+
+        /** Find the index of a named file using the perfect hash, or -1 if the archive doesn't contain the file. */
+        constexpr int find(std::string_view fileName) const noexcept
+        {
+            if (m_slots.empty()) {
+                return -1;
+            }
+
+            const auto hash = Embedded::hash(fileName);
+            const auto seed = m_seeds[Embedded::bucket(hash, m_seeds.size())];
+            const auto idx = m_slots[Embedded::slot(hash, seed, m_slots.size())];
+
+            if (Embedded::EmptySlot == idx || m_entries[idx].fileName != fileName) {
+                return -1;
+            }
+
+            return static_cast<int>(idx);
+        }
+
+        /** The embedded PACK archive. */
+        std::string_view m_archive;
+
+        /** The parsed index of the archive. */
+        std::span<const Embedded::IndexEntry> m_entries;
+
+        /** The displacement seed for each bucket of the perfect hash. */
+        std::span<const std::uint32_t> m_seeds;
+
+        /** The index of the file that hashes to each slot of the perfect hash, or EmptySlot. */
+        std::span<const std::uint32_t> m_slots;
+    };
+
+    /** Output a File from an embedded PACK archive to an output stream. */
+    std::ostream & operator<<(std::ostream & out, const EmbeddedReader::File & file) noexcept;
+}
+
+#endif
@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include "Hash.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+using namespace Id::Pack;
+
+
+namespace
+{
+    constexpr std::uint64_t Prime1 = 11400714785074694791ull;
+    constexpr std::uint64_t Prime2 = 14029467366897019727ull;
+    constexpr std::uint64_t Prime3 = 1609587929392839161ull;
+    constexpr std::uint64_t Prime4 = 9650029242287828579ull;
+    constexpr std::uint64_t Prime5 = 2870177450012600261ull;
+
+    /** The number of bytes XXH64 consumes per iteration of its four accumulators. */
+    constexpr std::size_t StripeSize = 32;
+
+    template<std::integral T>
+    T readLittle(const char * bytes) noexcept
+    {
+        T value;
+        std::memcpy(&value, bytes, sizeof(value));
+
+        if constexpr (std::endian::native != std::endian::little) {
+            value = std::byteswap(value);
+        }
+
+        return value;
+    }
+
+    std::uint64_t round(std::uint64_t acc, std::uint64_t input) noexcept
+    {
+        acc += input * Prime2;
+        acc = std::rotl(acc, 31);
+        return acc * Prime1;
+    }
+
+    std::uint64_t mergeRound(std::uint64_t acc, std::uint64_t value) noexcept
+    {
+        acc ^= round(0, value);
+        return acc * Prime1 + Prime4;
+    }
+
+    /** Consume whole stripes, returning the position after the last one. */
+    const char * consumeStripes(std::uint64_t (& acc)[4], const char * pos, const char * const end) noexcept
+    {
+        for (; pos + StripeSize <= end; pos += StripeSize) {
+            acc[0] = round(acc[0], readLittle<std::uint64_t>(pos));
+            acc[1] = round(acc[1], readLittle<std::uint64_t>(pos + 8));
+            acc[2] = round(acc[2], readLittle<std::uint64_t>(pos + 16));
+            acc[3] = round(acc[3], readLittle<std::uint64_t>(pos + 24));
+        }
+
+        return pos;
+    }
+
+    /** Mix the remaining (fewer than 32) bytes into the hash and apply the final avalanche. */
+    std::uint64_t finalise(std::uint64_t hash, const char * pos, const char * const end) noexcept
+    {
+        for (; pos + 8 <= end; pos += 8) {
+            hash ^= round(0, readLittle<std::uint64_t>(pos));
+            hash = std::rotl(hash, 27) * Prime1 + Prime4;
+        }
+
+        if (pos + 4 <= end) {
+            hash ^= readLittle<std::uint32_t>(pos) * Prime1;
+            hash = std::rotl(hash, 23) * Prime2 + Prime3;
+            pos += 4;
+        }
+
+        for (; pos < end; ++pos) {
+            hash ^= static_cast<std::uint8_t>(*pos) * Prime5;
+            hash = std::rotl(hash, 11) * Prime1;
+        }
+
+        hash ^= hash >> 33;
+        hash *= Prime2;
+        hash ^= hash >> 29;
+        hash *= Prime3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    /** Combine the lane accumulators once at least one stripe has been consumed. */
+    std::uint64_t converge(const std::uint64_t (& acc)[4]) noexcept
+    {
+        auto hash = std::rotl(acc[0], 1) + std::rotl(acc[1], 7) + std::rotl(acc[2], 12) + std::rotl(acc[3], 18);
+
+        for (const auto lane : acc) {
+            hash = mergeRound(hash, lane);
+        }
+
+        return hash;
+    }
+
+    /** The reflected CRC-32C polynomial. */
+    constexpr std::uint32_t Castagnoli = 0x82f63b78;
+
+    /** Lookup tables for the slicing-by-8 software CRC-32C. */
+    constexpr auto Crc32cTables = []() {
+        std::array<std::array<std::uint32_t, 256>, 8> tables{};
+
+        for (std::uint32_t byte = 0; byte < 256; ++byte) {
+            auto crc = byte;
+
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ ((0 - (crc & 1)) & Castagnoli);
+            }
+
+            tables[0][byte] = crc;
+        }
+
+        for (std::size_t table = 1; table < tables.size(); ++table) {
+            for (std::size_t byte = 0; byte < 256; ++byte) {
+                tables[table][byte] = (tables[table - 1][byte] >> 8) ^ tables[0][tables[table - 1][byte] & 0xff];
+            }
+        }
+
+        return tables;
+    }();
+
+    std::uint32_t crc32cSoftware(const char * pos, const char * const end, std::uint32_t crc) noexcept
+    {
+        for (; pos + 8 <= end; pos += 8) {
+            const auto word = readLittle<std::uint64_t>(pos) ^ crc;
+            crc = Crc32cTables[7][word & 0xff] ^ Crc32cTables[6][(word >> 8) & 0xff]
+                ^ Crc32cTables[5][(word >> 16) & 0xff] ^ Crc32cTables[4][(word >> 24) & 0xff]
+                ^ Crc32cTables[3][(word >> 32) & 0xff] ^ Crc32cTables[2][(word >> 40) & 0xff]
+                ^ Crc32cTables[1][(word >> 48) & 0xff] ^ Crc32cTables[0][word >> 56];
+        }
+
+        for (; pos < end; ++pos) {
+            crc = (crc >> 8) ^ Crc32cTables[0][(crc ^ static_cast<std::uint8_t>(*pos)) & 0xff];
+        }
+
+        return crc;
+    }
+
+#if defined(__x86_64__)
+    __attribute__((target("sse4.2")))
+    std::uint32_t crc32cHardware(const char * pos, const char * const end, std::uint32_t crc) noexcept
+    {
+        std::uint64_t crc64 = crc;
+
+        for (; pos + 8 <= end; pos += 8) {
+            crc64 = _mm_crc32_u64(crc64, readLittle<std::uint64_t>(pos));
+        }
+
+        crc = static_cast<std::uint32_t>(crc64);
+
+        for (; pos < end; ++pos) {
+            crc = _mm_crc32_u8(crc, static_cast<std::uint8_t>(*pos));
+        }
+
+        return crc;
+    }
+
+    const bool HasCrc32Instruction = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+
+Xxh64::Xxh64(std::uint64_t seed) noexcept
+: m_acc{seed + Prime1 + Prime2, seed + Prime2, seed, seed - Prime1},
+  m_seed(seed),
+  m_buffer{}
+{}
+
+
+Xxh64 & Xxh64::update(std::string_view data) noexcept
+{
+    const char * pos = data.data();
+    const char * const end = pos + data.size();
+    m_length += data.size();
+
+    if (0 < m_buffered) {
+        const auto bytes = std::min(StripeSize - m_buffered, data.size());
+        std::memcpy(m_buffer + m_buffered, pos, bytes);
+        m_buffered += bytes;
+        pos += bytes;
+
+        if (StripeSize > m_buffered) {
+            return *this;
+        }
+
+        consumeStripes(m_acc, m_buffer, m_buffer + StripeSize);
+        m_buffered = 0;
+    }
+
+    pos = consumeStripes(m_acc, pos, end);
+    std::memcpy(m_buffer, pos, end - pos);
+    m_buffered = end - pos;
+    return *this;
+}
+
+
+std::uint64_t Xxh64::digest() const noexcept
+{
+    const auto hash = (StripeSize <= m_length ? converge(m_acc) : m_seed + Prime5) + m_length;
+    return finalise(hash, m_buffer, m_buffer + m_buffered);
+}
+
+
+std::uint64_t Id::Pack::xxh64(std::string_view data, std::uint64_t seed) noexcept
+{
+    const char * pos = data.data();
+    const char * const end = pos + data.size();
+    std::uint64_t hash;
+
+    if (StripeSize <= data.size()) {
+        std::uint64_t acc[4] = {seed + Prime1 + Prime2, seed + Prime2, seed, seed - Prime1};
+        pos = consumeStripes(acc, pos, end);
+        hash = converge(acc);
+    } else {
+        hash = seed + Prime5;
+    }
+
+    return finalise(hash + data.size(), pos, end);
+}
+
+
+std::uint32_t Id::Pack::crc32c(std::string_view data, std::uint32_t crc) noexcept
+{
+    const char * const pos = data.data();
+    const char * const end = pos + data.size();
+    crc = ~crc;
+
+#if defined(__x86_64__)
+    if (HasCrc32Instruction) {
+        return ~crc32cHardware(pos, end, crc);
+    }
+#endif
+
+    return ~crc32cSoftware(pos, end, crc);
+}
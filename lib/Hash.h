@@ -0,0 +1,68 @@
+#ifndef LIBIDPAK_HASH_H
+#define LIBIDPAK_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace Id::Pack
+{
+    /**
+     * Hash some data with XXH64.
+     *
+     * This is a fast non-cryptographic hash, suitable for detecting identical content and accidental corruption - not
+     * for detecting tampering.
+     *
+     * @param data The data to hash.
+     * @param seed The seed for the hash.
+     *
+     * @return The 64-bit hash.
+     */
+    std::uint64_t xxh64(std::string_view data, std::uint64_t seed = 0) noexcept;
+
+    /**
+     * Hashes data with XXH64 incrementally, for content too large to hold in memory at once.
+     *
+     * Feeding the data in any number of pieces produces the same hash as xxh64() does for the whole.
+     */
+    class Xxh64
+    {
+    public:
+        /** @param seed The seed for the hash. */
+        explicit Xxh64(std::uint64_t seed = 0) noexcept;
+
+        /** Add some data to the hash. */
+        Xxh64 & update(std::string_view data) noexcept;
+
+        /** @return The hash of the data added so far. */
+        std::uint64_t digest() const noexcept;
+
+    private:
+        /** The four lane accumulators. */
+        std::uint64_t m_acc[4];
+
+        /** The seed, which is needed again for inputs shorter than a stripe. */
+        std::uint64_t m_seed;
+
+        /** The total number of bytes added. */
+        std::uint64_t m_length = 0;
+
+        /** Bytes awaiting a complete 32-byte stripe. */
+        char m_buffer[32];
+        std::size_t m_buffered = 0;
+    };
+
+    /**
+     * Compute the CRC-32C (Castagnoli) checksum of some data.
+     *
+     * The SSE 4.2 crc32 instruction is used when the CPU supports it, otherwise a table-driven implementation.
+     *
+     * @param data The data to checksum.
+     * @param crc The checksum of any preceding data, so that the checksum can be computed incrementally.
+     *
+     * @return The 32-bit checksum.
+     */
+    std::uint32_t crc32c(std::string_view data, std::uint32_t crc = 0) noexcept;
+}
+
+#endif
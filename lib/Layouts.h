@@ -0,0 +1,115 @@
+#ifndef LIBIDPAK_LAYOUTS_H
+#define LIBIDPAK_LAYOUTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include "Codecs.h"
+
+namespace Id::Pack
+{
+    /**
+     * Layout traits for the PACK archive format variants.
+     *
+     * Each layout describes the header identifier and the on-disk structure of the entries in the archive's index.
+     * BasicReader is specialised on a layout at compile time, so the parsing and lookup code for each variant carries no
+     * runtime checks for the format. Every layout has:
+     * - Id: the four-byte identifier at the start of the archive
+     * - NameLength: the size of the (NUL-padded) file name field in an index entry
+     * - EntrySize: the size of an index entry
+     * - Compressed: whether index entries carry a stored (compressed) size and a compression field after the file size
+     * - recognises(): for layouts with compression, whether a value of the compression field maps to a Codec
+     * - codec(): for layouts with compression, maps a recognised value of the compression field to the Codec it denotes
+     * - supports(): for layouts with compression, whether entries can be stored with a given Codec
+     * - compressionField(): for layouts with compression, maps a supported Codec to the value of the compression field
+     *
+     * In all layouts the name is followed immediately by the little-endian uint32 file offset and file size.
+     */
+
+    /** The original Quake PACK layout, also used by Quake II, Half-Life and many others. */
+    struct PackLayout
+    {
+        static constexpr std::string_view Id = "PACK";
+        static constexpr std::size_t NameLength = 56;
+        static constexpr std::size_t EntrySize = 64;
+        static constexpr bool Compressed = false;
+    };
+
+    /** The SiN SPAK layout, which has longer file names. */
+    struct SinLayout
+    {
+        static constexpr std::string_view Id = "SPAK";
+        static constexpr std::size_t NameLength = 120;
+        static constexpr std::size_t EntrySize = 128;
+        static constexpr bool Compressed = false;
+    };
+
+    /**
+     * The Daikatana PACK layout, whose entries may be compressed.
+     *
+     * The file size is the uncompressed size; it's followed by the stored size and a non-zero flag if the entry is
+     * compressed with the Daikatana codec.
+     */
+    struct DaikatanaLayout
+    {
+        static constexpr std::string_view Id = "PACK";
+        static constexpr std::size_t NameLength = 56;
+        static constexpr std::size_t EntrySize = 72;
+        static constexpr bool Compressed = true;
+
+        static constexpr bool recognises(std::uint32_t) noexcept
+        {
+            return true;
+        }
+
+        static constexpr Codec codec(std::uint32_t compressed) noexcept
+        {
+            return (0 == compressed ? Codec::None : Codec::Daikatana);
+        }
+
+        static constexpr bool supports(Codec codec) noexcept
+        {
+            return Codec::None == codec || Codec::Daikatana == codec;
+        }
+
+        static constexpr std::uint32_t compressionField(Codec codec) noexcept
+        {
+            return (Codec::None == codec ? 0 : 1);
+        }
+    };
+
+    /**
+     * The extended PAKX layout, in which each entry can be compressed with its own codec.
+     *
+     * This is the Daikatana layout, except that the compression field holds the Codec value for the entry.
+     */
+    struct ExtendedLayout
+    {
+        static constexpr std::string_view Id = "PAKX";
+        static constexpr std::size_t NameLength = 56;
+        static constexpr std::size_t EntrySize = 72;
+        static constexpr bool Compressed = true;
+
+        static constexpr bool recognises(std::uint32_t codec) noexcept
+        {
+            return static_cast<std::uint32_t>(Codec::Zstd) >= codec;
+        }
+
+        static constexpr Codec codec(std::uint32_t codec) noexcept
+        {
+            return static_cast<Codec>(codec);
+        }
+
+        static constexpr bool supports(Codec) noexcept
+        {
+            return true;
+        }
+
+        static constexpr std::uint32_t compressionField(Codec codec) noexcept
+        {
+            return static_cast<std::uint32_t>(codec);
+        }
+    };
+}
+
+#endif
@@ -1,7 +1,27 @@
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cassert>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <filesystem>
+#include <format>
 #include <fstream>
 #include <iostream>
-#include <sstream>
+#include <mutex>
+#include <poll.h>
+#include <set>
+#include <sys/eventfd.h>
+#include <sys/file.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include "Hash.h"
 #include "Reader.h"
 
 using namespace Id::Pack;
@@ -21,62 +41,280 @@ namespace
         return value;
     }
 
-    std::uint32_t readUint32(std::istream & in)
+    /** The byte size of the header of a PACK archive. */
+    constexpr std::size_t HeaderSize = 12;
+
+    /** The maximum number of bytes of file data read ahead of the threads extracting them. */
+    constexpr std::size_t MaxQueuedExtractionBytes = 64 * 1024 * 1024;
+
+    /** The size of the reads extractAll() makes to fetch runs of adjacent files (larger files are read whole). */
+    constexpr std::size_t ExtractionReadSize = 4 * 1024 * 1024;
+
+    /** The alignment of the buffers extractAll() reads into, so that reads fill whole pages. */
+    constexpr std::align_val_t ReadBufferAlignment{4096};
+
+    /** The size of a page of memory, to which page cache hints apply. */
+    const auto PageSize = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+
+    /** The largest gap between files preloaded or gathered with one read. */
+    constexpr std::uint64_t MaxCoalescedGap = 4096;
+
+    /** The number of lookups fileIndices() interleaves. */
+    constexpr std::size_t LookupBatchSize = 16;
+
+    /** How long, in milliseconds, a watched archive must go unchanged before it's reloaded. */
+    constexpr int ReloadSettleTime = 100;
+
+    /** The ID at the start of a shared index segment. */
+    constexpr std::string_view SharedIndexId = "IDSI";
+
+    /** The header of a shared index segment, which is followed by the index entries and the by-name index. */
+    struct SharedIndexHeader
+    {
+        char id[4];
+
+        /**
+         * Set to 1, last, once the segment is complete. The process creating the segment holds a lock on it until then,
+         * so that a segment that never became ready because its creator died can be told from one still being written.
+         */
+        std::atomic<std::uint32_t> ready;
+
+        std::uint32_t entrySize;
+        std::uint32_t entryCount;
+        std::uint32_t nameCount;
+
+        /** The XXH64 hash of the index as stored in the archive. */
+        std::uint64_t indexHash;
+    };
+
+    // the segment is shared between processes, so ready must be a plain 32-bit word that needs no lock of its own
+    static_assert(std::atomic<std::uint32_t>::is_always_lock_free && sizeof(std::uint32_t) == sizeof(std::atomic<std::uint32_t>));
+
+    /** Where the parts of a shared index segment lie. */
+    struct SharedIndexLayout
     {
-        static char bytes[4];
-        in.read(bytes, 4);
-        return littleToNative(*(reinterpret_cast<std::uint32_t *>(bytes)));
+        std::size_t entriesOffset;
+        std::size_t namesOffset;
+        std::size_t size;
+
+        template<class Entry>
+        static SharedIndexLayout of(std::size_t entryCount, std::size_t nameCount) noexcept
+        {
+            const auto entriesOffset = (sizeof(SharedIndexHeader) + alignof(Entry) - 1) / alignof(Entry) * alignof(Entry);
+            const auto namesOffset = entriesOffset + entryCount * sizeof(Entry);
+            static_assert(0 == sizeof(Entry) % alignof(std::uint32_t));
+            return {entriesOffset, namesOffset, namesOffset + nameCount * sizeof(std::uint32_t)};
+        }
+    };
+
+    std::uint32_t readUint32(const char * bytes)
+    {
+        std::uint32_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return littleToNative(value);
+    }
+
+    /**
+     * Determine where to extract an archived file to.
+     *
+     * @throws std::runtime_error if the file name is absolute or refers to a parent directory, as it would be extracted
+     * outside the directory.
+     */
+    std::filesystem::path extractionPath(const std::string & directory, const char * fileName)
+    {
+        const auto name = std::filesystem::path(fileName).relative_path();
+
+        if (name.empty() || name != std::filesystem::path(fileName) || std::ranges::any_of(name, [](const auto & part) { return ".." == part; })) {
+            throw std::runtime_error(std::format("File name \"{}\" can't be extracted safely", fileName));
+        }
+
+        return std::filesystem::path(directory) / name;
+    }
+
+    /** Allocate a page-aligned buffer for reading archive data. */
+    std::shared_ptr<char> allocateReadBuffer(std::size_t size)
+    {
+        return {
+            static_cast<char *>(::operator new(std::max<std::size_t>(1, size), ReadBufferAlignment)),
+            [](char * buffer) { ::operator delete(buffer, ReadBufferAlignment); }
+        };
+    }
+
+    /**
+     * Write an extracted file.
+     *
+     * The file's space is allocated before it's written (where the filesystem supports it), so that it can be laid out
+     * contiguously however the writes are interleaved with those of other files.
+     *
+     * @throws std::runtime_error if the file can't be written.
+     */
+    void writeFile(const std::filesystem::path & path, std::string_view content)
+    {
+        const auto fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+
+        if (0 > fd) {
+            throw std::runtime_error(std::format("Error opening file \"{}\": {}", path.string(), std::strerror(errno)));
+        }
+
+#if defined(__linux__)
+        if (!content.empty()) {
+            // failure only means the filesystem doesn't support preallocation
+            ::fallocate(fd, 0, 0, static_cast<off_t>(content.size()));
+        }
+#endif
+
+        while (!content.empty()) {
+            const auto written = ::write(fd, content.data(), content.size());
+
+            if (0 > written && EINTR == errno) {
+                continue;
+            }
+
+            if (0 > written) {
+                const auto err = errno;
+                ::close(fd);
+                throw std::runtime_error(std::format("Error writing file \"{}\": {}", path.string(), std::strerror(err)));
+            }
+
+            content.remove_prefix(written);
+        }
+
+        if (0 != ::close(fd)) {
+            throw std::runtime_error(std::format("Error writing file \"{}\": {}", path.string(), std::strerror(errno)));
+        }
     }
 }
 
 
-Reader::File::File(std::istream &in, std::istream::pos_type offset, std::streamsize size) noexcept
-: m_inStream(in),
+template<class Layout>
+BasicReader<Layout>::File::File(std::shared_ptr<const Source> source, std::uint64_t offset, std::streamsize size, std::streamsize storedSize, Codec codec, const char * preloaded) noexcept
+: m_source(std::move(source)),
   m_offset(offset),
-  m_size(size)
+  m_size(size),
+  m_storedSize(storedSize),
+  m_codec(codec),
+  m_preloaded(preloaded)
 {}
 
 
-void Reader::File::seek(int pos) noexcept
+template<class Layout>
+void BasicReader<Layout>::File::seek(int pos) noexcept
 {
     assert(0 <= pos && pos < size());
     m_readPos = pos;
 }
 
 
-std::string Reader::File::read(int bytes)
+template<class Layout>
+const std::string & BasicReader<Layout>::File::decompressed() const
 {
-    // stream is shared, other clients may have read so we have to reposition read cursor
-    m_inStream.seekg(m_readPos);
-    std::string ret(bytes, 0);
-    m_inStream.read(ret.data(), bytes);
+    if (!m_decompressed && m_preloaded) {
+        m_decompressed = std::make_shared<const std::string>(decompress(m_codec, std::string_view(m_preloaded, m_storedSize), m_size));
+    } else if (!m_decompressed) {
+        std::string stored(m_storedSize, 0);
+        m_source->read(m_offset, stored.data(), stored.size());
+        m_decompressed = std::make_shared<const std::string>(decompress(m_codec, stored, m_size));
+    }
 
-    if (m_inStream.fail()) {
+    return *m_decompressed;
+}
+
+
+template<class Layout>
+void BasicReader<Layout>::File::readData(char * data, int bytes)
+{
+    if (0 > bytes || bytes > m_size - m_readPos) {
         throw std::runtime_error("Error reading data for file");
     }
 
-    m_readPos = m_inStream.tellg() - m_offset;
+    if constexpr (Layout::Compressed) {
+        if (Codec::None != m_codec) {
+            decompressed().copy(data, bytes, static_cast<std::size_t>(m_readPos));
+            m_readPos += bytes;
+            return;
+        }
+    }
+
+    if (m_preloaded) {
+        if (bytes > m_storedSize - m_readPos) {
+            throw std::runtime_error("Error reading data for file");
+        }
+
+        std::memcpy(data, m_preloaded + m_readPos, bytes);
+    } else {
+        m_source->read(m_offset + m_readPos, data, bytes);
+    }
+
+    m_readPos += bytes;
+}
+
+
+template<class Layout>
+std::string BasicReader<Layout>::File::read(int bytes)
+{
+    std::string ret(bytes, 0);
+    readData(ret.data(), bytes);
+    return ret;
+}
+
+
+template<class Layout>
+std::pmr::string BasicReader<Layout>::File::read(int bytes, std::pmr::memory_resource * resource)
+{
+    std::pmr::string ret(bytes, 0, resource);
+    readData(ret.data(), bytes);
     return ret;
 }
 
 
-std::string Reader::File::contents() const noexcept
+template<class Layout>
+void BasicReader<Layout>::File::readContents(char * data) const noexcept
+{
+    if constexpr (Layout::Compressed) {
+        if (Codec::None != m_codec) {
+            try {
+                decompressed().copy(data, size());
+            } catch (const std::runtime_error &) {
+                std::fill_n(data, size(), 0);
+            }
+
+            return;
+        }
+    }
+
+    if (m_preloaded) {
+        std::memcpy(data, m_preloaded, size());
+        return;
+    }
+
+    try {
+        m_source->read(m_offset, data, size());
+    } catch (const std::runtime_error &) {
+        std::fill_n(data, size(), 0);
+    }
+}
+
+
+template<class Layout>
+std::string BasicReader<Layout>::File::contents() const noexcept
 {
-    m_inStream.seekg(m_offset);
     std::string ret(size(), 0);
-    m_inStream.read(ret.data(), size());
+    readContents(ret.data());
     return ret;
 }
 
 
-std::ostream & Id::Pack::operator<<(std::ostream & out, const Reader::File & file) noexcept
+template<class Layout>
+std::pmr::string BasicReader<Layout>::File::contents(std::pmr::memory_resource * resource) const noexcept
 {
-    out << static_cast<std::string>(file);
-    return out;
+    std::pmr::string ret(size(), 0, resource);
+    readContents(ret.data());
+    return ret;
 }
 
 
-const Reader::Iterator Reader::Iterator::operator++(int)
+template<class Layout>
+const typename BasicReader<Layout>::Iterator BasicReader<Layout>::Iterator::operator++(int)
 {
     Iterator ret(*this);
 
@@ -88,7 +326,8 @@ const Reader::Iterator Reader::Iterator::operator++(int)
 }
 
 
-Reader::Iterator & Reader::Iterator::operator++()
+template<class Layout>
+typename BasicReader<Layout>::Iterator & BasicReader<Layout>::Iterator::operator++()
 {
     if (m_index < m_reader.fileCount()) {
         ++m_index;
@@ -98,199 +337,1388 @@ Reader::Iterator & Reader::Iterator::operator++()
 }
 
 
-const Reader::File Reader::Iterator::operator*() const
+template<class Layout>
+const typename BasicReader<Layout>::File BasicReader<Layout>::Iterator::operator*() const
 {
     return m_reader.file(m_index);
 }
 
 
-Reader::File Reader::Iterator::operator*()
+template<class Layout>
+typename BasicReader<Layout>::File BasicReader<Layout>::Iterator::operator*()
 {
     return m_reader.file(m_index);
 }
 
-const Reader::File Reader::Iterator::operator->() const
+template<class Layout>
+const typename BasicReader<Layout>::File BasicReader<Layout>::Iterator::operator->() const
 {
     return m_reader.file(m_index);
 }
 
 
-Reader::File Reader::Iterator::operator->()
+template<class Layout>
+typename BasicReader<Layout>::File BasicReader<Layout>::Iterator::operator->()
 {
     return m_reader.file(m_index);
 }
 
 
-Reader::Reader(std::istream & in)
-: Reader(&in, false)
+template<class Layout>
+BasicReader<Layout>::BasicReader(std::istream & in, std::pmr::memory_resource * resource)
+: BasicReader(std::allocate_shared<StreamSource>(std::pmr::polymorphic_allocator<>(resource), in), {}, resource)
 {}
 
 
-Reader::Reader(const std::string & fileName)
-: Reader(new std::ifstream(fileName), true)
+template<class Layout>
+BasicReader<Layout>::BasicReader(const std::string & fileName, std::pmr::memory_resource * resource)
+: BasicReader(std::allocate_shared<FileSource>(std::pmr::polymorphic_allocator<>(resource), fileName), std::filesystem::absolute(fileName).string(), resource)
 {}
 
 
-Reader::Reader(std::istream * in, bool owned)
-: m_inStream(in),
-  m_ownedStream(owned),
-  m_header{}
+template<class Layout>
+BasicReader<Layout>::BasicReader(std::shared_ptr<const Source> source, std::string fileName, std::pmr::memory_resource * resource)
+: m_fileName(std::move(fileName)),
+  m_resource(resource)
+{
+    assert(source);
+    const auto header = readHeader(*source);
+    m_index = std::allocate_shared<Index>(std::pmr::polymorphic_allocator<>(resource), std::move(source), header, resource);
+}
+
+
+template<class Layout>
+BasicReader<Layout>::~BasicReader() noexcept
+{
+    unwatch();
+
+    try {
+        stopTrace();
+    } catch (const std::exception &) {
+    }
+}
+
+
+template<class Layout>
+BasicReader<Layout>::Index::Index(std::shared_ptr<const Source> source, const Header & header, std::pmr::memory_resource * resource)
+: source(std::move(source)),
+  header(header),
+  fileIndex(resource),
+  fileIndexByName(resource),
+  preloaded(resource),
+  preloadedRuns(resource)
+{}
+
+
+template<class Layout>
+BasicReader<Layout>::Index::~Index() noexcept
+{
+    if (sharedIndex) {
+        ::munmap(sharedIndex, sharedIndexSize);
+    }
+}
+
+
+template<class Layout>
+void BasicReader<Layout>::Index::releaseLoadedIndex() noexcept
 {
-    assert(nullptr != in);
-    in->seekg(0);
-    in->read(m_header.id, 4);
+    fileIndex.clear();
+    fileIndex.shrink_to_fit();
+    fileIndexByName.clear();
+    fileIndexByName.shrink_to_fit();
+}
+
+
+template<class Layout>
+typename BasicReader<Layout>::Header BasicReader<Layout>::readHeader(const Source & source)
+{
+    std::array<char, HeaderSize> bytes{};
+    auto headerSize = HeaderSize;
+
+    try {
+        source.read(0, bytes.data(), HeaderSize);
+    } catch (const std::runtime_error &) {
+        // report a truncated archive as an incorrect identifier
+        headerSize = std::min<std::size_t>(HeaderSize, source.size());
+        source.read(0, bytes.data(), headerSize);
+    }
+
+    const auto id = std::string_view(bytes.data(), std::min<std::size_t>(4, headerSize));
 
-    if (std::string("PACK") != m_header.id) {
-        throw std::runtime_error((std::ostringstream() << "Header identifier incorrect - expected \"PACK\" found \"" << m_header.id << "\"").str());
+    if (Layout::Id != id || HeaderSize != headerSize) {
+        throw std::runtime_error(std::format(R"(Header identifier incorrect - expected "{}" found "{}")", Layout::Id, id));
     }
 
-    m_header.indexOffset = readUint32(*in);
-    m_header.indexSize = readUint32(*in);
+    Header header{};
+    std::memcpy(header.id, bytes.data(), 4);
+    header.indexOffset = readUint32(bytes.data() + 4);
+    header.indexSize = readUint32(bytes.data() + 8);
+    return header;
+}
+
+
+template<class Layout>
+void BasicReader<Layout>::ensureIndex() const noexcept
+{
+    std::call_once(m_indexLoaded, [this]() {
+        // the first snapshot isn't visible to other threads until the index is loaded
+        loadIndex(*m_index, nullptr);
+    });
 }
 
 
-Reader::~Reader() noexcept
+template<class Layout>
+bool BasicReader<Layout>::loadIndex(Index & index, const Index * previous) const noexcept
 {
-    if (m_ownedStream) {
-        delete m_inStream;
+    std::string segmentName;
+
+    if (m_shareIndex) {
+        segmentName = sharedIndexName(index);
+
+        if (!segmentName.empty() && attachSharedIndex(index, segmentName)) {
+            preload(index);
+            return true;
+        }
+    }
+
+    if (!readIndex(index, previous)) {
+        return false;
     }
 
-    m_inStream = nullptr;
+    index.entries = index.fileIndex;
+    index.entriesByName = index.fileIndexByName;
+
+    if (!segmentName.empty()) {
+        publishSharedIndex(index, segmentName);
+    }
+
+    preload(index);
+    return true;
 }
 
 
-void Reader::ensureIndex() const noexcept
+template<class Layout>
+void BasicReader<Layout>::preload(Index & index) const noexcept
 {
-    if (0 == m_fileIndex.size()) {
-        m_fileIndex.clear();
-        m_fileIndexByName.clear();
-        m_inStream->seekg(m_header.indexOffset);
+    if (0 == m_preloadMaxFileSize || 0 == m_preloadBudget) {
+        return;
+    }
+
+    std::vector<const IndexEntry *> files;
+
+    for (const auto & entry : index.entries) {
+        if (0 < entry.storedSize && m_preloadMaxFileSize >= entry.storedSize) {
+            files.push_back(&entry);
+        }
+    }
+
+    std::ranges::sort(files, {}, [](const IndexEntry * entry) { return entry->fileOffset; });
+
+    // plan runs of files close enough together to read at once, in offset order, until the budget is spent
+    auto & runs = index.preloadedRuns;
+    std::uint64_t preloadedSize = 0;
+
+    for (const auto * entry : files) {
+        const std::uint64_t start = entry->fileOffset;
+        const std::uint64_t end = start + entry->storedSize;
+
+        if (!runs.empty() && runs.back().offset + runs.back().size + MaxCoalescedGap >= start) {
+            auto & run = runs.back();
+            const auto runEnd = std::max(run.offset + run.size, end);
+            const auto growth = runEnd - (run.offset + run.size);
+
+            if (m_preloadBudget - preloadedSize < growth) {
+                break;
+            }
+
+            run.size += growth;
+            preloadedSize += growth;
+            continue;
+        }
+
+        if (m_preloadBudget - preloadedSize < entry->storedSize) {
+            break;
+        }
 
-        for (int idx = 0; idx < fileCount(); ++idx) {
-            IndexEntry entry;
-            m_inStream->read(entry.fileName, 56);
-            entry.index = idx;
+        runs.push_back({start, entry->storedSize, preloadedSize});
+        preloadedSize += entry->storedSize;
+    }
 
-            entry.fileOffset = readUint32(*m_inStream);
-            entry.fileSize = readUint32(*m_inStream);
+    index.preloaded.resize(preloadedSize);
 
-            m_fileIndexByName[entry.fileName] = entry;
-            m_fileIndex.push_back(entry);
+    try {
+        for (const auto & run : runs) {
+            index.source->read(run.offset, index.preloaded.data() + run.preloadedOffset, run.size);
         }
+    } catch (const std::runtime_error &) {
+        // files that can't be preloaded are read from the archive as usual
+        index.preloaded.clear();
+        index.preloaded.shrink_to_fit();
+        runs.clear();
     }
 }
 
 
-int Reader::fileCount() const noexcept
+template<class Layout>
+const char * BasicReader<Layout>::preloadedData(const Index & index, const IndexEntry & entry) noexcept
 {
-    return m_header.indexSize / sizeof(IndexEntry);
+    // only the stored data is preloaded, which for an uncompressed file must be all of its content
+    if (0 == entry.storedSize || (Codec::None == entry.codec && entry.storedSize != entry.fileSize)) {
+        return nullptr;
+    }
+
+    const auto next = std::ranges::upper_bound(index.preloadedRuns, std::uint64_t{entry.fileOffset}, {}, &PreloadedRun::offset);
+
+    if (index.preloadedRuns.begin() == next) {
+        return nullptr;
+    }
+
+    const auto & run = *(next - 1);
+
+    if (run.offset + run.size < std::uint64_t{entry.fileOffset} + entry.storedSize) {
+        return nullptr;
+    }
+
+    return index.preloaded.data() + run.preloadedOffset + (entry.fileOffset - run.offset);
 }
 
 
-bool Reader::has(const std::string & fileName) const noexcept
+template<class Layout>
+std::uint64_t BasicReader<Layout>::preloadedSize() const noexcept
 {
     ensureIndex();
-    return m_fileIndexByName.contains(fileName);
+    return current()->preloaded.size();
+}
+
+
+template<class Layout>
+bool BasicReader<Layout>::readIndex(Index & index, const Index * previous) const noexcept
+{
+    const auto count = index.header.indexSize / Layout::EntrySize;
+
+    // the whole index is read at once; an archive whose index can't be read has no files
+    std::pmr::string bytes(count * Layout::EntrySize, 0, m_resource);
+
+    try {
+        index.source->read(index.header.indexOffset, bytes.data(), bytes.size());
+    } catch (const std::runtime_error &) {
+        return false;
+    }
+
+    index.indexHash = xxh64(bytes);
+
+    // if the archive has only been appended to, its index starts with the previous one, whose entries can be reused
+    std::uint32_t reused = 0;
+
+    if (previous && previous->entries.size() <= count && previous->indexHash == xxh64(std::string_view(bytes).substr(0, previous->entries.size() * Layout::EntrySize))) {
+        reused = static_cast<std::uint32_t>(previous->entries.size());
+    }
+
+    auto & fileIndex = index.fileIndex;
+    auto & fileIndexByName = index.fileIndexByName;
+    fileIndex.reserve(count);
+    fileIndexByName.reserve(count);
+
+    if (0 < reused) {
+        fileIndex.assign(previous->entries.begin(), previous->entries.begin() + reused);
+    }
+
+    const char * entryBytes = bytes.data() + reused * Layout::EntrySize;
+
+    for (auto idx = reused; idx < count; ++idx, entryBytes += Layout::EntrySize) {
+        IndexEntry entry{};
+        std::memcpy(entry.fileName, entryBytes, Layout::NameLength);
+        entry.index = static_cast<int>(idx);
+
+        entry.fileOffset = readUint32(entryBytes + Layout::NameLength);
+        entry.fileSize = readUint32(entryBytes + Layout::NameLength + 4);
+
+        if constexpr (Layout::Compressed) {
+            entry.storedSize = readUint32(entryBytes + Layout::NameLength + 8);
+            const auto compression = readUint32(entryBytes + Layout::NameLength + 12);
+
+            // an entry whose codec isn't known can't be read, and an uncompressed entry whose stored size isn't its
+            // size can't be either; both suggest the index isn't what it seems
+            if (!Layout::recognises(compression)
+                || (Codec::None == Layout::codec(compression) && entry.storedSize != entry.fileSize)) {
+                fileIndex.clear();
+                fileIndexByName.clear();
+                return false;
+            }
+
+            entry.codec = Layout::codec(compression);
+        } else {
+            entry.storedSize = entry.fileSize;
+            entry.codec = Codec::None;
+        }
+
+        fileIndex.push_back(entry);
+        fileIndexByName.push_back(idx);
+    }
+
+    // sort the new entries by name, keeping files with the same name in index order, then keep only the last file with
+    // each name
+    const auto name = [&fileIndex](std::uint32_t idx) { return std::string_view(fileIndex[idx].fileName); };
+    std::ranges::stable_sort(fileIndexByName, {}, name);
+
+    const auto keepLast = [&name](auto begin, auto end) {
+        auto last = begin;
+
+        for (auto it = begin; it != end; ++it) {
+            if (last != begin && name(*(last - 1)) == name(*it)) {
+                *(last - 1) = *it;
+            } else {
+                *last++ = *it;
+            }
+        }
+
+        return last;
+    };
+
+    fileIndexByName.erase(keepLast(fileIndexByName.begin(), fileIndexByName.end()), fileIndexByName.end());
+
+    if (0 < reused) {
+        // merge with the reused entries, which come first so that the added ones take precedence
+        const auto added = fileIndexByName.size();
+        fileIndexByName.insert(fileIndexByName.begin(), previous->entriesByName.begin(), previous->entriesByName.end());
+        std::ranges::inplace_merge(fileIndexByName, fileIndexByName.end() - added, {}, name);
+        fileIndexByName.erase(keepLast(fileIndexByName.begin(), fileIndexByName.end()), fileIndexByName.end());
+    }
+
+    return true;
+}
+
+
+template<class Layout>
+std::string BasicReader<Layout>::sharedIndexName(const Index & index) const noexcept
+{
+    struct stat info{};
+
+    if (0 > index.source->fileDescriptor() || 0 != ::fstat(index.source->fileDescriptor(), &info)) {
+        return {};
+    }
+
+    // the segment is specific to the archive's content (as far as its metadata can tell) and this build's index entries
+    const auto identity = std::format(
+        "{}:{}:{}:{}:{}.{}:{}:{}:{}",
+        Layout::Id,
+        sizeof(IndexEntry),
+        info.st_dev,
+        info.st_ino,
+        info.st_size,
+        info.st_mtim.tv_sec,
+        info.st_mtim.tv_nsec,
+        index.header.indexOffset,
+        index.header.indexSize
+    );
+
+    return std::format("/idpak-{:016x}", xxh64(identity));
+}
+
+
+template<class Layout>
+bool BasicReader<Layout>::attachSharedIndex(Index & index, const std::string & segmentName) const noexcept
+{
+    const auto fd = ::shm_open(segmentName.c_str(), O_RDONLY | O_CLOEXEC, 0);
+
+    if (0 > fd) {
+        return false;
+    }
+
+    struct stat info{};
+    void * mapping = MAP_FAILED;
+
+    // only segments published by this user are trusted; anyone else could have put anything in them
+    if (0 == ::fstat(fd, &info) && ::geteuid() == info.st_uid && sizeof(SharedIndexHeader) <= static_cast<std::size_t>(info.st_size)) {
+        mapping = ::mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+
+    ::close(fd);
+
+    if (MAP_FAILED == mapping) {
+        return false;
+    }
+
+    const auto size = static_cast<std::size_t>(info.st_size);
+    const auto * header = static_cast<const SharedIndexHeader *>(mapping);
+    const auto layout = SharedIndexLayout::of<IndexEntry>(header->entryCount, header->nameCount);
+
+    // a segment still being published (or abandoned part-way through) isn't used
+    if (SharedIndexId != std::string_view(header->id, 4)
+        || 1 != header->ready.load(std::memory_order_acquire)
+        || sizeof(IndexEntry) != header->entrySize
+        || index.header.indexSize / Layout::EntrySize != header->entryCount
+        || header->entryCount < header->nameCount
+        || layout.size > size) {
+        ::munmap(mapping, size);
+        return false;
+    }
+
+    const auto * bytes = static_cast<const char *>(mapping);
+    const std::span entries(reinterpret_cast<const IndexEntry *>(bytes + layout.entriesOffset), header->entryCount);
+    const std::span entriesByName(reinterpret_cast<const std::uint32_t *>(bytes + layout.namesOffset), header->nameCount);
+
+    // every lookup trusts the entries, so they're checked as thoroughly as when they're read from the archive
+    const auto validEntry = [&entries](const IndexEntry & entry) {
+        return nullptr != std::memchr(entry.fileName, 0, sizeof(entry.fileName))
+            && Codec::Zstd >= entry.codec
+            && (Codec::None != entry.codec || entry.storedSize == entry.fileSize)
+            && &entry - entries.data() == entry.index;
+    };
+
+    const auto validName = [&header](std::uint32_t idx) { return header->entryCount > idx; };
+
+    if (!std::ranges::all_of(entries, validEntry) || !std::ranges::all_of(entriesByName, validName)) {
+        ::munmap(mapping, size);
+        return false;
+    }
+
+    index.entries = entries;
+    index.entriesByName = entriesByName;
+    index.indexHash = header->indexHash;
+    index.sharedIndex = mapping;
+    index.sharedIndexSize = size;
+    return true;
+}
+
+
+template<class Layout>
+bool BasicReader<Layout>::reclaimSharedIndex(const std::string & segmentName) const noexcept
+{
+    const auto fd = ::shm_open(segmentName.c_str(), O_RDONLY | O_CLOEXEC, 0);
+
+    if (0 > fd) {
+        // removed meanwhile, so there's nothing to reclaim
+        return ENOENT == errno;
+    }
+
+    // a segment that couldn't be attached and isn't locked by its creator will never become usable
+    struct stat info{};
+    const auto abandoned = (0 == ::fstat(fd, &info) && ::geteuid() == info.st_uid && 0 == ::flock(fd, LOCK_EX | LOCK_NB));
+    ::close(fd);
+    return abandoned && (0 == ::shm_unlink(segmentName.c_str()) || ENOENT == errno);
 }
 
 
-std::string Reader::fileName(int idx) const noexcept
+template<class Layout>
+void BasicReader<Layout>::publishSharedIndex(Index & index, const std::string & segmentName) const noexcept
+{
+    // only one process creates the segment; the others attach once it's complete, or use their own index until then. A
+    // segment left incomplete (or invalid) by a process that has gone is removed, and created again
+    auto fd = ::shm_open(segmentName.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+
+    if (0 > fd && EEXIST == errno) {
+        if (attachSharedIndex(index, segmentName)) {
+            index.releaseLoadedIndex();
+            return;
+        }
+
+        if (reclaimSharedIndex(segmentName)) {
+            fd = ::shm_open(segmentName.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        }
+    }
+
+    if (0 > fd) {
+        return;
+    }
+
+    // the lock is held until the segment is ready. Another process may have found the segment unlocked in the moment
+    // before it was taken and removed it, in which case there's no longer anything to publish to
+    const auto layout = SharedIndexLayout::of<IndexEntry>(index.fileIndex.size(), index.fileIndexByName.size());
+    struct stat info{};
+    void * mapping = MAP_FAILED;
+
+    if (0 == ::flock(fd, LOCK_EX) && 0 == ::fstat(fd, &info) && 0 < info.st_nlink && 0 == ::ftruncate(fd, static_cast<off_t>(layout.size))) {
+        mapping = ::mmap(nullptr, layout.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    if (MAP_FAILED == mapping) {
+        if (0 < info.st_nlink) {
+            ::shm_unlink(segmentName.c_str());
+        }
+
+        ::close(fd);
+        return;
+    }
+
+    auto * bytes = static_cast<char *>(mapping);
+    auto * header = new (mapping) SharedIndexHeader{};
+    SharedIndexId.copy(header->id, 4);
+    header->entrySize = sizeof(IndexEntry);
+    header->entryCount = static_cast<std::uint32_t>(index.fileIndex.size());
+    header->nameCount = static_cast<std::uint32_t>(index.fileIndexByName.size());
+    header->indexHash = index.indexHash;
+    std::memcpy(bytes + layout.entriesOffset, index.fileIndex.data(), index.fileIndex.size() * sizeof(IndexEntry));
+    std::memcpy(bytes + layout.namesOffset, index.fileIndexByName.data(), index.fileIndexByName.size() * sizeof(std::uint32_t));
+    header->ready.store(1, std::memory_order_release);
+    ::mprotect(mapping, layout.size, PROT_READ);
+    ::close(fd);
+
+    // use the shared copy, and release the private one
+    index.entries = {reinterpret_cast<const IndexEntry *>(bytes + layout.entriesOffset), index.fileIndex.size()};
+    index.entriesByName = {reinterpret_cast<const std::uint32_t *>(bytes + layout.namesOffset), index.fileIndexByName.size()};
+    index.sharedIndex = mapping;
+    index.sharedIndexSize = layout.size;
+    index.releaseLoadedIndex();
+}
+
+
+template<class Layout>
+bool BasicReader<Layout>::sharesIndex() const noexcept
 {
-    assert(0 <= idx && fileCount() > idx);
     ensureIndex();
-    return m_fileIndex[idx].fileName;
+    return nullptr != current()->sharedIndex;
+}
+
+
+template<class Layout>
+void BasicReader<Layout>::removeSharedIndex() const noexcept
+{
+    if (const auto segmentName = sharedIndexName(*current()); !segmentName.empty()) {
+        ::shm_unlink(segmentName.c_str());
+    }
 }
 
 
-int Reader::fileIndex(const std::string & fileName) const noexcept
+template<class Layout>
+ReloadResult BasicReader<Layout>::reload()
 {
+    if (m_fileName.empty()) {
+        return ReloadResult::Unchanged;
+    }
+
     ensureIndex();
-    assert(has(fileName));
-    return m_fileIndexByName[fileName].index;
+    std::lock_guard lock(m_reloadMutex);
+    const auto previous = current();
+    struct stat fileInfo{};
+    struct stat sourceInfo{};
+
+    if (0 != ::stat(m_fileName.c_str(), &fileInfo)) {
+        // the archive is part-way through being replaced
+        return ReloadResult::Failed;
+    }
+
+    std::shared_ptr<Index> index;
+
+    try {
+        // an archive that's been written to in place is still read from the same source; a replaced one is reopened
+        auto source = previous->source;
+        const auto sameFile = (0 == ::fstat(source->fileDescriptor(), &sourceInfo) && fileInfo.st_dev == sourceInfo.st_dev && fileInfo.st_ino == sourceInfo.st_ino);
+
+        if (!sameFile) {
+            source = std::allocate_shared<FileSource>(std::pmr::polymorphic_allocator<>(m_resource), m_fileName);
+        }
+
+        const auto header = readHeader(*source);
+
+        if (sameFile && header.indexOffset == previous->header.indexOffset && header.indexSize == previous->header.indexSize && matches(*previous)) {
+            return ReloadResult::Unchanged;
+        }
+
+        index = std::allocate_shared<Index>(std::pmr::polymorphic_allocator<>(m_resource), std::move(source), header, m_resource);
+
+        if (!loadIndex(*index, (sameFile ? previous.get() : nullptr))) {
+            return ReloadResult::Failed;
+        }
+    } catch (const std::runtime_error &) {
+        return ReloadResult::Failed;
+    }
+
+    // the previous snapshot is destroyed once the calls and Files using it are done with it, with the lock released
+    {
+        std::lock_guard indexLock(m_indexMutex);
+        m_index.swap(index);
+    }
+
+    m_generation.fetch_add(1, std::memory_order_release);
+    return ReloadResult::Reloaded;
 }
 
 
-int Reader::fileOffset(int idx) const noexcept
+template<class Layout>
+bool BasicReader<Layout>::matches(const Index & index) const noexcept
+{
+    try {
+        std::string bytes(index.header.indexSize / Layout::EntrySize * Layout::EntrySize, 0);
+        index.source->read(index.header.indexOffset, bytes.data(), bytes.size());
+
+        if (xxh64(bytes) != index.indexHash) {
+            return false;
+        }
+
+        // the files' content may have changed even though the index hasn't, which only matters for content held in memory
+        for (const auto & run : index.preloadedRuns) {
+            bytes.resize(run.size);
+            index.source->read(run.offset, bytes.data(), bytes.size());
+
+            if (0 != std::memcmp(bytes.data(), index.preloaded.data() + run.preloadedOffset, run.size)) {
+                return false;
+            }
+        }
+    } catch (const std::runtime_error &) {
+        return false;
+    }
+
+    return true;
+}
+
+
+template<class Layout>
+void BasicReader<Layout>::watch()
+{
+    if (m_fileName.empty()) {
+        throw std::runtime_error("Archives read from streams can't be watched");
+    }
+
+    if (m_watcher.joinable()) {
+        return;
+    }
+
+    const auto directory = std::filesystem::path(m_fileName).parent_path();
+    const auto inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    const auto wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    // the directory is watched, rather than the file, so that archives renamed into place are seen
+    if (0 > inotifyFd || 0 > wakeFd || 0 > ::inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE)) {
+        const auto err = errno;
+
+        for (const auto fd : {inotifyFd, wakeFd}) {
+            if (0 <= fd) {
+                ::close(fd);
+            }
+        }
+
+        throw std::runtime_error(std::format(R"(Error watching "{}": {})", directory.string(), std::strerror(err)));
+    }
+
+    m_watcherWakeFd = wakeFd;
+    m_watcher = std::jthread([this, inotifyFd, wakeFd](std::stop_token stopToken) {
+        watchArchive(stopToken, inotifyFd, wakeFd);
+    });
+}
+
+
+template<class Layout>
+void BasicReader<Layout>::unwatch() noexcept
+{
+    if (!m_watcher.joinable()) {
+        return;
+    }
+
+    m_watcher.request_stop();
+    const std::uint64_t wake = 1;
+    [[maybe_unused]] const auto written = ::write(m_watcherWakeFd, &wake, sizeof(wake));
+    m_watcher.join();
+
+    // closed here rather than by the watcher, which may have stopped early, so that it's never written to once closed
+    ::close(m_watcherWakeFd);
+    m_watcherWakeFd = -1;
+}
+
+
+template<class Layout>
+void BasicReader<Layout>::watchArchive(std::stop_token stopToken, int inotifyFd, int wakeFd) noexcept
+{
+    const auto archiveName = std::filesystem::path(m_fileName).filename().string();
+    alignas(inotify_event) char events[4096];
+    bool changed = false;
+
+    while (!stopToken.stop_requested()) {
+        std::array<pollfd, 2> fds = {{{inotifyFd, POLLIN, 0}, {wakeFd, POLLIN, 0}}};
+
+        // once the archive has changed, wait for it to settle before reloading it
+        const auto ready = ::poll(fds.data(), fds.size(), (changed ? ReloadSettleTime : -1));
+
+        if (0 > ready && EINTR != errno) {
+            break;
+        }
+
+        if (0 == ready && changed) {
+            // a reload that couldn't allocate what it needed is tried again once the next settling time has passed
+            try {
+                reload();
+                changed = false;
+            } catch (const std::exception &) {
+            }
+
+            continue;
+        }
+
+        if (0 == (fds[0].revents & POLLIN)) {
+            continue;
+        }
+
+        for (auto bytes = ::read(inotifyFd, events, sizeof(events)); 0 < bytes; bytes = ::read(inotifyFd, events, sizeof(events))) {
+            for (const char * event = events; event < events + bytes;) {
+                const auto * inotifyEvent = reinterpret_cast<const inotify_event *>(event);
+
+                if (0 < inotifyEvent->len && archiveName == inotifyEvent->name) {
+                    changed = true;
+                }
+
+                event += sizeof(inotify_event) + inotifyEvent->len;
+            }
+        }
+    }
+
+    ::close(inotifyFd);
+}
+
+
+template<class Layout>
+const typename BasicReader<Layout>::IndexEntry * BasicReader<Layout>::findEntry(const Index & index, std::string_view fileName) noexcept
+{
+    const auto found = std::ranges::lower_bound(index.entriesByName, fileName, {}, [&index](std::uint32_t idx) { return std::string_view(index.entries[idx].fileName); });
+
+    if (index.entriesByName.end() == found || fileName != index.entries[*found].fileName) {
+        return nullptr;
+    }
+
+    return &index.entries[*found];
+}
+
+
+template<class Layout>
+const typename BasicReader<Layout>::IndexEntry * BasicReader<Layout>::entryAt(const Index & index, int idx) noexcept
+{
+    return (0 <= idx && index.entries.size() > static_cast<std::size_t>(idx) ? &index.entries[idx] : nullptr);
+}
+
+
+template<class Layout>
+typename BasicReader<Layout>::File BasicReader<Layout>::openFile(std::shared_ptr<const Index> index, const IndexEntry * entry) const noexcept
+{
+    if (!entry) {
+        return {fileSource(std::move(index)), 0, 0, 0, Codec::None, nullptr};
+    }
+
+    const auto * preloaded = preloadedData(*index, *entry);
+    traceAccess(entry->index);
+
+    // the File holds on to the snapshot, so the entry stays valid whatever order the arguments are evaluated in
+    return {fileSource(std::move(index)), entry->fileOffset, entry->fileSize, entry->storedSize, entry->codec, preloaded};
+}
+
+
+template<class Layout>
+int BasicReader<Layout>::fileCount() const noexcept
+{
+    ensureIndex();
+    return static_cast<int>(current()->entries.size());
+}
+
+
+template<class Layout>
+bool BasicReader<Layout>::has(std::string_view fileName) const noexcept
 {
-    assert(0 <= idx && fileCount() > idx);
     ensureIndex();
-    return static_cast<int>(m_fileIndex[idx].fileOffset);
+    return nullptr != findEntry(*current(), fileName);
 }
 
 
-int Reader::fileOffset(const std::string & fileName) const noexcept
+template<class Layout>
+std::string BasicReader<Layout>::fileName(int idx) const noexcept
 {
     ensureIndex();
-    assert(has(fileName));
-    return static_cast<int>(m_fileIndexByName[fileName].fileOffset);
+    const auto index = current();
+    const auto * entry = entryAt(*index, idx);
+    return (entry ? entry->fileName : "");
 }
 
-int Reader::fileSize(int idx) const noexcept
+
+template<class Layout>
+std::pmr::string BasicReader<Layout>::fileName(int idx, std::pmr::memory_resource * resource) const noexcept
+{
+    ensureIndex();
+    const auto index = current();
+    const auto * entry = entryAt(*index, idx);
+    return {(entry ? entry->fileName : ""), resource};
+}
+
+
+template<class Layout>
+int BasicReader<Layout>::fileIndex(std::string_view fileName) const noexcept
+{
+    ensureIndex();
+    const auto * entry = findEntry(*current(), fileName);
+    return (entry ? entry->index : -1);
+}
+
+
+template<class Layout>
+void BasicReader<Layout>::fileIndices(std::span<const std::string_view> fileNames, std::span<int> indices) const noexcept
+{
+    assert(fileNames.size() == indices.size());
+    ensureIndex();
+    const auto index = current();
+    const auto & byName = index->entriesByName;
+
+    if (byName.empty()) {
+        std::ranges::fill(indices, -1);
+        return;
+    }
+
+    const auto entryAt = [&index, &byName](std::size_t position) -> const IndexEntry & {
+        return index->entries[byName[position]];
+    };
+
+    // the searches in each batch proceed in lockstep, taking the same number of steps whatever they compare. Each step
+    // prefetches the entry every search is about to compare with before comparing any, so the cache misses of the batch
+    // overlap rather than following one another
+    for (std::size_t batchStart = 0; batchStart < fileNames.size(); batchStart += LookupBatchSize) {
+        const auto batchSize = std::min(LookupBatchSize, fileNames.size() - batchStart);
+        const auto names = fileNames.subspan(batchStart, batchSize);
+        std::array<std::size_t, LookupBatchSize> first{};
+
+        for (auto length = byName.size(); 1 < length;) {
+            const auto half = length / 2;
+
+            for (std::size_t search = 0; search < batchSize; ++search) {
+                __builtin_prefetch(&entryAt(first[search] + half));
+            }
+
+            for (std::size_t search = 0; search < batchSize; ++search) {
+                if (std::string_view(entryAt(first[search] + half).fileName) < names[search]) {
+                    first[search] += half;
+                }
+            }
+
+            length -= half;
+        }
+
+        for (std::size_t search = 0; search < batchSize; ++search) {
+            // first is now the last entry before the name, or the first entry if no entry is before it
+            auto position = first[search];
+
+            if (std::string_view(entryAt(position).fileName) < names[search]) {
+                ++position;
+            }
+
+            indices[batchStart + search] = (byName.size() > position && names[search] == entryAt(position).fileName ? entryAt(position).index : -1);
+        }
+    }
+}
+
+
+template<class Layout>
+std::vector<int> BasicReader<Layout>::fileIndices(std::span<const std::string_view> fileNames) const
+{
+    std::vector<int> indices(fileNames.size());
+    fileIndices(fileNames, indices);
+    return indices;
+}
+
+
+template<class Layout>
+int BasicReader<Layout>::fileOffset(int idx) const noexcept
+{
+    ensureIndex();
+    const auto index = current();
+    const auto * entry = entryAt(*index, idx);
+    return (entry ? static_cast<int>(entry->fileOffset) : 0);
+}
+
+
+template<class Layout>
+int BasicReader<Layout>::fileOffset(std::string_view fileName) const noexcept
 {
-    assert(0 <= idx && fileCount() > idx);
     ensureIndex();
-    return static_cast<int>(m_fileIndex[idx].fileSize);
+    const auto index = current();
+    const auto * entry = findEntry(*index, fileName);
+    return (entry ? static_cast<int>(entry->fileOffset) : 0);
+}
+
+template<class Layout>
+int BasicReader<Layout>::fileSize(int idx) const noexcept
+{
+    ensureIndex();
+    const auto index = current();
+    const auto * entry = entryAt(*index, idx);
+    return (entry ? static_cast<int>(entry->fileSize) : 0);
 }
 
 
-int Reader::fileSize(const std::string & fileName) const noexcept
+template<class Layout>
+int BasicReader<Layout>::fileSize(std::string_view fileName) const noexcept
 {
     ensureIndex();
-    assert(has(fileName));
-    return static_cast<int>(m_fileIndexByName[fileName].fileSize);
+    const auto index = current();
+    const auto * entry = findEntry(*index, fileName);
+    return (entry ? static_cast<int>(entry->fileSize) : 0);
 }
 
 
-Reader::File Reader::file(int idx) const noexcept
+template<class Layout>
+int BasicReader<Layout>::storedSize(int idx) const noexcept
 {
-    assert(0 <= idx && fileCount() > idx);
     ensureIndex();
-    return {*m_inStream, m_fileIndex[idx].fileOffset, m_fileIndex[idx].fileSize};
+    const auto index = current();
+    const auto * entry = entryAt(*index, idx);
+    return (entry ? static_cast<int>(entry->storedSize) : 0);
 }
 
 
-Reader::File Reader::file(const std::string & fileName) const noexcept
+template<class Layout>
+Codec BasicReader<Layout>::fileCodec(int idx) const noexcept
 {
     ensureIndex();
-    assert(has(fileName));
-    const auto & indexEntry = m_fileIndexByName[fileName];
-    return {*m_inStream, indexEntry.fileOffset, indexEntry.fileSize};
+    const auto index = current();
+    const auto * entry = entryAt(*index, idx);
+    return (entry ? entry->codec : Codec::None);
 }
 
 
-void Reader::extract(int idx, std::ostream & out) const
+template<class Layout>
+typename BasicReader<Layout>::File BasicReader<Layout>::file(int idx) const noexcept
 {
-    out << file(idx);
+    ensureIndex();
+    auto index = current();
+    const auto * entry = entryAt(*index, idx);
+    return openFile(std::move(index), entry);
 }
 
 
-void Reader::extract(const std::string & fileName, std::ostream & out) const
+template<class Layout>
+typename BasicReader<Layout>::File BasicReader<Layout>::file(std::string_view fileName) const noexcept
 {
-    out << file(fileName);
+    ensureIndex();
+    auto index = current();
+    const auto * entry = findEntry(*index, fileName);
+    return openFile(std::move(index), entry);
 }
 
 
-void Reader::extract(int idx, const std::string & outputFile) const
+template<class Layout>
+typename BasicReader<Layout>::GatheredFiles BasicReader<Layout>::gather(std::span<const int> indices, std::size_t alignment) const
+{
+    assert(std::has_single_bit(alignment));
+    ensureIndex();
+    const auto index = current();
+
+    // lay the files out in the order requested
+    GatheredFiles gathered;
+    std::vector<std::size_t> offsets;
+    offsets.reserve(indices.size());
+
+    for (const auto idx : indices) {
+        if (!entryAt(*index, idx)) {
+            throw std::runtime_error(std::format("Error reading data for file {}: there's no such file in the archive", idx));
+        }
+
+        gathered.size = (gathered.size + alignment - 1) / alignment * alignment;
+        offsets.push_back(gathered.size);
+        gathered.size += index->entries[idx].fileSize;
+    }
+
+    auto * resource = m_resource;
+    const auto allocated = std::max<std::size_t>(1, gathered.size);
+    gathered.buffer = {
+        static_cast<char *>(resource->allocate(allocated, alignment)),
+        [resource, allocated, alignment](char * buffer) { resource->deallocate(buffer, allocated, alignment); }
+    };
+
+    // read the files in the order they're stored; compressed files are read into a buffer of their own and decompressed
+    // into place
+    std::vector<std::size_t> order;
+    std::vector<std::string> compressed(indices.size());
+
+    // an uncompressed file is read straight into its slot, which holds no more than its size
+    const auto bytesToRead = [](const IndexEntry & entry) {
+        return (Codec::None == entry.codec ? std::min(entry.storedSize, entry.fileSize) : entry.storedSize);
+    };
+
+    for (std::size_t file = 0; file < indices.size(); ++file) {
+        const auto & entry = index->entries[indices[file]];
+        auto * destination = gathered.buffer.get() + offsets[file];
+        gathered.files.emplace_back(destination, entry.fileSize);
+
+        traceAccess(indices[file]);
+
+        if (Codec::None != entry.codec) {
+            compressed[file].resize(entry.storedSize);
+        }
+
+        if (const auto * preloaded = preloadedData(*index, entry)) {
+            if (Codec::None == entry.codec) {
+                std::memcpy(destination, preloaded, bytesToRead(entry));
+            } else {
+                compressed[file].assign(preloaded, entry.storedSize);
+            }
+        } else if (0 < entry.storedSize) {
+            order.push_back(file);
+        }
+    }
+
+    std::ranges::sort(order, {}, [&index, &indices](std::size_t file) { return index->entries[indices[file]].fileOffset; });
+
+    // gaps between files read together are read into, and discarded from, one scratch buffer
+    std::string gap(MaxCoalescedGap, 0);
+    std::vector<std::span<char>> buffers;
+
+    for (auto run = order.cbegin(); run != order.cend();) {
+        const auto & first = index->entries[indices[*run]];
+        const std::uint64_t runStart = first.fileOffset;
+        std::uint64_t runEnd = runStart;
+        buffers.clear();
+
+        // a file that overlaps the one before it (such as the same file requested twice) starts a new run
+        for (; run != order.cend(); ++run) {
+            const auto file = *run;
+            const auto & entry = index->entries[indices[file]];
+
+            if (!buffers.empty() && (runEnd > entry.fileOffset || runEnd + MaxCoalescedGap < entry.fileOffset)) {
+                break;
+            }
+
+            if (runEnd < entry.fileOffset) {
+                buffers.emplace_back(gap.data(), entry.fileOffset - runEnd);
+            }
+
+            buffers.emplace_back((Codec::None == entry.codec ? gathered.buffer.get() + offsets[file] : compressed[file].data()), bytesToRead(entry));
+            runEnd = std::uint64_t{entry.fileOffset} + bytesToRead(entry);
+        }
+
+        try {
+            index->source->readScattered(runStart, buffers);
+        } catch (const std::runtime_error &) {
+            throw std::runtime_error(std::format("Error reading data for file \"{}\"", first.fileName));
+        }
+    }
+
+    if constexpr (Layout::Compressed) {
+        for (std::size_t file = 0; file < indices.size(); ++file) {
+            const auto & entry = index->entries[indices[file]];
+
+            if (Codec::None != entry.codec) {
+                decompress(entry.codec, compressed[file], entry.fileSize).copy(gathered.buffer.get() + offsets[file], entry.fileSize);
+            }
+        }
+    }
+
+    return gathered;
+}
+
+
+template<class Layout>
+void BasicReader<Layout>::extract(int idx, std::ostream & out) const
+{
+    ensureIndex();
+    auto index = current();
+    const auto * entry = entryAt(*index, idx);
+
+    if (!entry) {
+        throw std::runtime_error(std::format("Error reading data for file {}: there's no such file in the archive", idx));
+    }
+
+    // read() rather than contents() so that errors reading or decompressing the file are reported
+    auto content = openFile(std::move(index), entry);
+    out << content.read(content.size());
+}
+
+
+template<class Layout>
+void BasicReader<Layout>::extract(std::string_view fileName, std::ostream & out) const
+{
+    ensureIndex();
+    auto index = current();
+    const auto * entry = findEntry(*index, fileName);
+
+    if (!entry) {
+        throw std::runtime_error(std::format(R"(Error reading data for file "{}": there's no such file in the archive)", fileName));
+    }
+
+    // read() rather than contents() so that errors reading or decompressing the file are reported
+    auto content = openFile(std::move(index), entry);
+    out << content.read(content.size());
+}
+
+
+template<class Layout>
+void BasicReader<Layout>::extract(int idx, const std::string & outputFile) const
 {
     auto out = std::ofstream(outputFile);
     extract(idx, out);
 }
 
 
-void Reader::extract(const std::string & fileName, const std::string & outputFile) const
+template<class Layout>
+void BasicReader<Layout>::extract(std::string_view fileName, const std::string & outputFile) const
 {
     auto out = std::ofstream(outputFile);
     extract(fileName, out);
 }
 
 
-Reader::Iterator Reader::begin()
+template<class Layout>
+void BasicReader<Layout>::startTrace(const std::string & traceFileName)
+{
+    auto trace = std::make_unique<AccessTrace>(traceFileName, traceFingerprint());
+    retireTrace(m_trace.exchange(trace.release()));
+}
+
+
+template<class Layout>
+void BasicReader<Layout>::stopTrace()
+{
+    retireTrace(m_trace.exchange(nullptr));
+}
+
+
+template<class Layout>
+void BasicReader<Layout>::traceAccess(int idx) const noexcept
+{
+    // tracing is rare, so accesses only count themselves as users while it's active
+    if (!m_trace.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    // counting the user before loading the trace means that a trace replaced after it's loaded isn't destroyed until the
+    // access is recorded
+    m_traceUsers.fetch_add(1);
+
+    if (auto * trace = m_trace.load()) {
+        trace->record(idx);
+    }
+
+    m_traceUsers.fetch_sub(1, std::memory_order_release);
+}
+
+
+template<class Layout>
+void BasicReader<Layout>::retireTrace(AccessTrace * trace) const
+{
+    if (!trace) {
+        return;
+    }
+
+    // the trace is destroyed even if it can't be written
+    const std::unique_ptr<AccessTrace> retired(trace);
+
+    while (0 < m_traceUsers.load()) {
+        std::this_thread::yield();
+    }
+
+    retired->write();
+}
+
+
+template<class Layout>
+TraceFingerprint BasicReader<Layout>::traceFingerprint() const noexcept
+{
+    ensureIndex();
+    const auto index = current();
+    return {static_cast<std::uint32_t>(index->entries.size()), index->header.indexOffset, index->header.indexSize};
+}
+
+
+template<class Layout>
+void BasicReader<Layout>::extractAll(const std::string & directory, unsigned int threads, bool dropBehind) const
+{
+    ensureIndex();
+
+    // the whole extraction uses the same snapshot of the index, even if the archive is reloaded part-way through
+    const auto index = current();
+
+    if (0 == threads) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // only the last file with any given name is extracted, and files are read in the order they're stored
+    struct Extraction
+    {
+        const IndexEntry * entry;
+        std::filesystem::path path;
+    };
+
+    std::vector<Extraction> extractions;
+    extractions.reserve(index->entriesByName.size());
+
+    for (const auto idx : index->entriesByName) {
+        const auto & entry = index->entries[idx];
+        extractions.push_back({&entry, extractionPath(directory, entry.fileName)});
+    }
+
+    std::ranges::sort(extractions, {}, [](const Extraction & extraction) { return extraction.entry->fileOffset; });
+
+    // create the directory tree up front, once for each distinct directory, so the workers only create files
+    std::set<std::filesystem::path> directories = {directory};
+
+    for (const auto & extraction : extractions) {
+        directories.insert(extraction.path.parent_path());
+    }
+
+    for (const auto & path : directories) {
+        std::filesystem::create_directories(path);
+    }
+
+    struct Job
+    {
+        const Extraction * extraction;
+
+        /** The buffer holding the stored content, shared with the other files read with it. */
+        std::shared_ptr<const char> buffer;
+        std::string_view stored;
+
+        /** The number of bytes of buffer this job accounts for in the queue (only the first job for each buffer does). */
+        std::size_t queuedBytes;
+    };
+
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable spaceReady;
+    std::deque<Job> jobs;
+    std::size_t queuedBytes = 0;
+    bool finished = false;
+    std::exception_ptr failure;
+
+    const auto fail = [&](std::exception_ptr err) {
+        std::lock_guard lock(mutex);
+
+        if (!failure) {
+            failure = err;
+        }
+
+        finished = true;
+        jobs.clear();
+        jobReady.notify_all();
+        spaceReady.notify_all();
+    };
+
+    const auto work = [&]() {
+        while (true) {
+            Job job;
+
+            {
+                std::unique_lock lock(mutex);
+                jobReady.wait(lock, [&]() { return !jobs.empty() || finished; });
+
+                if (jobs.empty()) {
+                    return;
+                }
+
+                job = std::move(jobs.front());
+                jobs.pop_front();
+                queuedBytes -= job.queuedBytes;
+            }
+
+            spaceReady.notify_one();
+
+            try {
+                const auto * entry = job.extraction->entry;
+
+                if constexpr (Layout::Compressed) {
+                    if (Codec::None != entry->codec) {
+                        writeFile(job.extraction->path, decompress(entry->codec, job.stored, entry->fileSize));
+                        continue;
+                    }
+                }
+
+                writeFile(job.extraction->path, job.stored);
+            } catch (...) {
+                fail(std::current_exception());
+                return;
+            }
+        }
+    };
+
+    {
+        std::vector<std::jthread> workers;
+
+        for (unsigned int thread = 0; thread < threads; ++thread) {
+            workers.emplace_back(work);
+        }
+
+        try {
+            index->source->advise(0, 0, AccessHint::Sequential);
+
+            // read runs of adjacent files with one large read each
+            for (auto run = extractions.cbegin(); run != extractions.cend();) {
+                const std::uint64_t runStart = run->entry->fileOffset;
+                std::uint64_t runEnd = runStart + run->entry->storedSize;
+                auto runLast = run + 1;
+
+                for (; runLast != extractions.cend(); ++runLast) {
+                    const auto end = std::max<std::uint64_t>(runEnd, runLast->entry->fileOffset + runLast->entry->storedSize);
+
+                    if (ExtractionReadSize < end - runStart) {
+                        break;
+                    }
+
+                    runEnd = end;
+                }
+
+                const auto buffer = allocateReadBuffer(runEnd - runStart);
+
+                try {
+                    index->source->read(runStart, buffer.get(), runEnd - runStart);
+                } catch (const std::runtime_error &) {
+                    throw std::runtime_error(std::format("Error reading data for file \"{}\"", run->entry->fileName));
+                }
+
+                if (dropBehind) {
+                    // the run is buffered, so its pages can go - including the one it starts in, which the last run's hint kept as it
+                    // was only partly within that run
+                    const auto dropStart = runStart - runStart % PageSize;
+                    index->source->advise(dropStart, runEnd - dropStart, AccessHint::DontNeed);
+                }
+
+                std::unique_lock lock(mutex);
+                spaceReady.wait(lock, [&]() { return queuedBytes < MaxQueuedExtractionBytes || jobs.empty() || finished; });
+
+                if (finished) {
+                    break;
+                }
+
+                queuedBytes += runEnd - runStart;
+
+                for (auto accounted = runEnd - runStart; run != runLast; ++run, accounted = 0) {
+                    const auto stored = std::string_view(buffer.get() + (run->entry->fileOffset - runStart), run->entry->storedSize);
+                    jobs.push_back({&*run, buffer, stored, accounted});
+                }
+
+                lock.unlock();
+                jobReady.notify_all();
+            }
+        } catch (...) {
+            fail(std::current_exception());
+        }
+
+        std::lock_guard lock(mutex);
+        finished = true;
+        jobReady.notify_all();
+    }
+
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+}
+
+
+template<class Layout>
+typename BasicReader<Layout>::Iterator BasicReader<Layout>::begin()
 {
     return Iterator(*this, 0);
 }
 
 
-Reader::Iterator Reader::end()
+template<class Layout>
+typename BasicReader<Layout>::Iterator BasicReader<Layout>::end()
 {
     return Iterator(*this, fileCount());
 }
+
+
+template class Id::Pack::BasicReader<PackLayout>;
+template class Id::Pack::BasicReader<SinLayout>;
+template class Id::Pack::BasicReader<DaikatanaLayout>;
+template class Id::Pack::BasicReader<ExtendedLayout>;
+
+
+std::string Id::Pack::formatId(const std::string & fileName)
+{
+    std::string id(4, 0);
+    std::ifstream in(fileName, std::ios::binary);
+    in.read(id.data(), 4);
+    id.resize(in.gcount());
+    return id;
+}
@@ -1,30 +1,68 @@
 #ifndef LIBIDPAK_PACKREADER_H
 #define LIBIDPAK_PACKREADER_H
 
+#include <atomic>
 #include <cstdint>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <optional>
+#include <span>
+#include <thread>
 #include <string>
 #include <vector>
+#include "AccessTrace.h"
+#include "Layouts.h"
+#include "Source.h"
 
 namespace Id::Pack
 {
     /**
-     * Reads ID PACK archives (.pak).
+     * The outcome of reloading an archive.
      */
-    class Reader
+    enum class ReloadResult
+    {
+        /** The archive had changed, and the reader now reads it as it is. */
+        Reloaded,
+
+        /** The archive hasn't changed since it was loaded. */
+        Unchanged,
+
+        /** The archive couldn't be read, for example part-way through being written, and was left as it was. */
+        Failed,
+    };
+
+    /**
+     * Reads ID PACK archives (.pak), and the variants of the format described by the layouts in Layouts.h.
+     *
+     * The reader is specialised on the layout at compile time. It is instantiated in the library for PackLayout,
+     * SinLayout, DaikatanaLayout and ExtendedLayout - use the Reader, SinReader, DaikatanaReader and ExtendedReader
+     * aliases, or withReader() to open an archive with the reader for its format.
+     *
+     * The index is allocated from a memory resource provided when the reader is created, so that short-lived readers
+     * can be allocated from an arena and released in one step.
+     */
+    template<class Layout>
+    class BasicReader
     {
     public:
+        /** The layout of the archives the reader reads. */
+        using LayoutType = Layout;
+
+        /** The default number of bytes of small files to preload (see setPreload()). */
+        static constexpr std::uint64_t DefaultPreloadBudget = 16 * 1024 * 1024;
+
         /**
-         * A thin wrapper around the PACK file stream for a single file in the archive.
+         * A thin wrapper around the PACK archive source for a single file in the archive.
          *
          * Think of this as a sort of std::span for the portion of the PACK archive that contains a single file.
          */
         class File
         {
         // the reader is a friend so that it can construct File instances
-        friend class Reader;
+        friend class BasicReader;
 
         public:
             /** @return The size, in bytes, of the file. */
@@ -33,6 +71,12 @@ namespace Id::Pack
                 return static_cast<int>(m_size);
             }
 
+            /** @return The byte offset of the file's (stored) data inside the PACK archive. */
+            int location() const noexcept
+            {
+                return static_cast<int>(m_offset);
+            }
+
             /** @return The offset from the start of the file from which the next byte will be read. */
             int pos() const noexcept
             {
@@ -54,9 +98,21 @@ namespace Id::Pack
             /** Seek to a given byte offset in the file. */
             void seek(int pos) noexcept;
 
-            /** Read a number of bytes from the file, starting at the current read position. */
+            /**
+             * Read a number of bytes from the file, starting at the current read position.
+             *
+             * @throws std::runtime_error if the data can't be read.
+             */
             std::string read(int bytes);
 
+            /**
+             * Read a number of bytes from the file, starting at the current read position, into a string allocated
+             * from a memory resource.
+             *
+             * @throws std::runtime_error if the data can't be read.
+             */
+            std::pmr::string read(int bytes, std::pmr::memory_resource * resource);
+
             /**
              * Read all the content of the file.
              *
@@ -65,6 +121,13 @@ namespace Id::Pack
              */
             std::string contents() const noexcept;
 
+            /**
+             * Read all the content of the file into a string allocated from a memory resource.
+             *
+             * The current read position is unaffected by this call.
+             */
+            std::pmr::string contents(std::pmr::memory_resource * resource) const noexcept;
+
             /**
              * Cast the File to a string.
              *
@@ -78,21 +141,99 @@ namespace Id::Pack
                 return contents();
             }
 
+            /**
+             * View the content of the file without copying it.
+             *
+             * This is only possible for files preloaded by the reader (see setPreload()) that aren't compressed. The view
+             * is valid for as long as the File, or any copy of it.
+             *
+             * @return The content of the file, or empty if it wasn't preloaded.
+             */
+            std::optional<std::string_view> view() const noexcept
+            {
+                if (!m_preloaded || Codec::None != m_codec) {
+                    return {};
+                }
+
+                return std::string_view(m_preloaded, static_cast<std::size_t>(m_size));
+            }
+
+            /**
+             * Advise the OS how the file's content is about to be accessed.
+             *
+             * @param hint How the content will be accessed. WillNeed starts reading the content ahead of the first
+             * read, and DontNeed releases it from the page cache once it's been read.
+             */
+            void advise(AccessHint hint) const noexcept
+            {
+                m_source->advise(m_offset, static_cast<std::uint64_t>(m_storedSize), hint);
+            }
+
+            /** Output a File from a PACK archive to an output stream. */
+            friend std::ostream & operator<<(std::ostream & out, const File & file) noexcept
+            {
+                out << static_cast<std::string>(file);
+                return out;
+            }
+
         private:
             // there's no public constructor, only Reader objects can instantiate Files
-            File(std::istream & in, std::istream::pos_type offset, std::streamsize size) noexcept;
+            File(std::shared_ptr<const Source> source, std::uint64_t offset, std::streamsize size, std::streamsize storedSize, Codec codec, const char * preloaded = nullptr) noexcept;
+
+            /**
+             * Fetch the decompressed content of a compressed file.
+             *
+             * The content is decompressed on first use and shared by all copies of the File.
+             */
+            const std::string & decompressed() const;
+
+            /** Read bytes from the current read position into a buffer, advancing the read position. */
+            void readData(char * data, int bytes);
 
-            /** The stream for the PACK archive that contains the file. */
-            std::istream & m_inStream;
+            /** Read all the content of the file into a buffer of size() bytes. */
+            void readContents(char * data) const noexcept;
 
-            /** The byte offset in the stream where the file starts. */
-            std::istream::pos_type m_offset;
+            /**
+             * The source for the PACK archive that contains the file. It shares ownership of the snapshot of the archive
+             * the File was obtained from, keeping the source and any preloaded data alive after the archive is reloaded.
+             */
+            std::shared_ptr<const Source> m_source;
 
-            /** The sie in bytes of the file. */
+            /** The byte offset in the archive where the file starts. */
+            std::uint64_t m_offset;
+
+            /** The size in bytes of the file. */
             std::streamsize m_size;
 
+            /** The size in bytes of the file as stored in the archive. This differs from m_size if it's compressed. */
+            std::streamsize m_storedSize;
+
+            /** The codec the file is stored with. This is only ever not None for layouts that support compression. */
+            Codec m_codec;
+
+            /** The file's data as stored in the archive, if the reader preloaded it. */
+            const char * m_preloaded;
+
+            /** The content of a compressed file, once decompressed. */
+            mutable std::shared_ptr<const std::string> m_decompressed;
+
             /** For random access, the current read position (relative to the offset of the start of the file). */
-            std::istream::pos_type m_readPos = 0;
+            std::streamsize m_readPos = 0;
+        };
+
+        /**
+         * The content of a set of files, gathered into one buffer.
+         */
+        struct GatheredFiles
+        {
+            /** The buffer holding the content of the files. */
+            std::shared_ptr<char> buffer;
+
+            /** The size of the buffer in bytes. */
+            std::size_t size = 0;
+
+            /** The content of each file in the buffer, in the order the files were requested. */
+            std::vector<std::span<const char>> files;
         };
 
         /**
@@ -102,7 +243,7 @@ namespace Id::Pack
         class Iterator final
         {
         // the reader is a friend so that it can construct Iterator instances
-        friend class Reader;
+        friend class BasicReader;
 
         public:
             /** Copy an iterator. */
@@ -155,13 +296,13 @@ namespace Id::Pack
         private:
             // there is no public constructor other than the copy and move constructors - only Reader instances can
             // create new iterators
-            explicit Iterator(Reader & reader, int index)
+            explicit Iterator(BasicReader & reader, int index)
             : m_reader(reader),
               m_index(index)
             {}
 
             /** The Reader whose files are being iterated. */
-            Reader & m_reader;
+            BasicReader & m_reader;
 
             /**
              * The 0-based index of the file the iterator points to.
@@ -175,26 +316,76 @@ namespace Id::Pack
         /**
          * Initialise a new Reader to read a PACK archive from a file.
          *
+         * The file is read with positional reads, so files from the archive can be read on several threads at once.
+         *
          * @param fileName The file to read.
+         * @param resource The memory resource from which to allocate the index.
+         * @throws std::runtime_error if the file is not an archive with the reader's layout.
          */
-        explicit Reader(const std::string & fileName);
+        explicit BasicReader(const std::string & fileName, std::pmr::memory_resource * resource = std::pmr::get_default_resource());
 
         /**
          * @param stream The stream to read from. The caller is responsible for ensuring the stream lives as long
-         * as the reader using it (and any files it yields).
+         * as the reader using it (and any files it yields). Reads from the stream are serialised.
+         * @param resource The memory resource from which to allocate the index. The caller is responsible for ensuring
+         * the resource lives as long as the reader.
+         * @throws std::runtime_error if the stream does not contain an archive with the reader's layout.
          */
-        explicit Reader(std::istream & stream);
+        explicit BasicReader(std::istream & stream, std::pmr::memory_resource * resource = std::pmr::get_default_resource());
 
         // Reader instances can't be copied or moved
-        Reader(const Reader &) = delete;
-        Reader(Reader &&) = delete;
-        void operator = (const Reader &) = delete;
-        void operator = (Reader &&) = delete;
-        virtual ~Reader() noexcept;
+        BasicReader(const BasicReader &) = delete;
+        BasicReader(BasicReader &&) = delete;
+        void operator = (const BasicReader &) = delete;
+        void operator = (BasicReader &&) = delete;
+        virtual ~BasicReader() noexcept;
+
+        /** @return The memory resource from which the index is allocated. */
+        std::pmr::memory_resource * resource() const noexcept
+        {
+            return m_resource;
+        }
 
-        /** @return The number of files in the PACK archive. */
+        /**
+         * @return The number of files in the PACK archive. This is 0 if the index can't be read, or has an entry whose
+         * codec isn't recognised.
+         */
         int fileCount() const noexcept;
 
+        /** @return The byte offset of the index in the archive, as recorded in the header. */
+        std::uint32_t indexOffset() const noexcept
+        {
+            return current()->header.indexOffset;
+        }
+
+        /** @return The byte size of the index in the archive, as recorded in the header. */
+        std::uint32_t indexSize() const noexcept
+        {
+            return current()->header.indexSize;
+        }
+
+        /**
+         * @return The source from which the archive is read. It keeps the source open even if the archive is reloaded
+         * from another file meanwhile.
+         */
+        std::shared_ptr<const Source> source() const noexcept
+        {
+            return fileSource(current());
+        }
+
+        /**
+         * Advise the OS how the archive as a whole is about to be accessed.
+         *
+         * Sequential suits jobs that read the whole archive in order, and Random suits lookups of small files in no
+         * particular order. Use File::advise() for hints about individual files.
+         *
+         * @param hint How the archive will be accessed.
+         */
+        void advise(AccessHint hint) const noexcept
+        {
+            current()->source->advise(0, 0, hint);
+        }
+
         /**
          * Check whether a named file exists in the archive.
          *
@@ -204,12 +395,13 @@ namespace Id::Pack
          *
          * @param fileName The name of the file to look for.
          */
-        bool has(const std::string & fileName) const noexcept;
+        bool has(std::string_view fileName) const noexcept;
 
         /**
          * Look up the name of a file from its position in the archive.
          *
-         * The provided index must be >= 0 and < fileCount().
+         * The index should be >= 0 and < fileCount(). If there's no file at the index, which can happen if the archive
+         * has been reloaded since the index was found, the name is empty.
          *
          * @param idx The 0-based index of the file.
          *
@@ -218,20 +410,48 @@ namespace Id::Pack
         std::string fileName(int idx) const noexcept;
 
         /**
-         * Look up the index of a named file in the archive.
+         * Look up the name of a file from its position in the archive, into a string allocated from a memory resource.
          *
-         * The provided file name must be in the archive, as determined by has().
+         * The index should be >= 0 and < fileCount(). If there's no file at the index, which can happen if the archive
+         * has been reloaded since the index was found, the name is empty.
+         */
+        std::pmr::string fileName(int idx, std::pmr::memory_resource * resource) const noexcept;
+
+        /**
+         * Look up the index of a named file in the archive.
          *
          * @param fileName The file to look for.
          *
-         * @return The index of the file.
+         * @return The index of the file, or -1 if it's not in the archive.
+         */
+        int fileIndex(std::string_view fileName) const noexcept;
+
+        /**
+         * Look up the indices of several named files in the archive at once.
+         *
+         * This is quicker than calling has() and fileIndex() for each name when resolving many names, because the
+         * lookups are interleaved so that their memory accesses overlap. Names are matched as strictly as by has().
+         *
+         * @param fileNames The files to look for.
+         * @param indices Receives the index of each file, or -1 for each file not in the archive. It must be the same size
+         * as fileNames.
+         */
+        void fileIndices(std::span<const std::string_view> fileNames, std::span<int> indices) const noexcept;
+
+        /**
+         * Look up the indices of several named files in the archive at once.
+         *
+         * @param fileNames The files to look for.
+         *
+         * @return The index of each file, or -1 for each file not in the archive.
          */
-        int fileIndex(const std::string & fileName) const noexcept;
+        std::vector<int> fileIndices(std::span<const std::string_view> fileNames) const;
 
         /**
          * Look up the byte offset of a file in the archive.
          *
-         * The provided index must be >= 0 and < fileCount().
+         * The index should be >= 0 and < fileCount(). If there's no file at the index, which can happen if the archive
+         * has been reloaded since the index was found, 0 is returned.
          *
          * @param idx The 0-based index of the file.
          *
@@ -242,18 +462,22 @@ namespace Id::Pack
         /**
          * Look up the byte offset of a file in the archive.
          *
-         * The provided file name must be in the archive, as determined by has().
+         * If there's no file with the name, which can happen if the archive has been reloaded since it was found by
+         * has(), 0 is returned.
          *
          * @param fileName The file to look for.
          *
          * @return The byte offset of the file inside the PACK archive.
          */
-        int fileOffset(const std::string & fileName) const noexcept;
+        int fileOffset(std::string_view fileName) const noexcept;
 
         /**
          * Look up the byte size of a file in the archive.
          *
-         * The provided index must be >= 0 and < fileCount().
+         * For compressed files this is the uncompressed size.
+         *
+         * The index should be >= 0 and < fileCount(). If there's no file at the index, which can happen if the archive
+         * has been reloaded since the index was found, 0 is returned.
          *
          * @param idx The 0-based index of the file.
          *
@@ -264,18 +488,48 @@ namespace Id::Pack
         /**
          * Look up the byte size of a file in the archive.
          *
-         * The provided file name must be in the archive, as determined by has().
+         * For compressed files this is the uncompressed size.
+         *
+         * If there's no file with the name, which can happen if the archive has been reloaded since it was found by
+         * has(), 0 is returned.
          *
          * @param fileName The file to look for.
          *
          * @return The byte size of the file inside the PACK archive.
          */
-        int fileSize(const std::string & fileName) const noexcept;
+        int fileSize(std::string_view fileName) const noexcept;
+
+        /**
+         * Look up the number of bytes a file occupies in the archive.
+         *
+         * This differs from the file size only for compressed files.
+         *
+         * The index should be >= 0 and < fileCount(). If there's no file at the index, which can happen if the archive
+         * has been reloaded since the index was found, 0 is returned.
+         *
+         * @param idx The 0-based index of the file.
+         *
+         * @return The byte size of the file's data as stored in the PACK archive.
+         */
+        int storedSize(int idx) const noexcept;
+
+        /**
+         * Look up the codec a file is stored with.
+         *
+         * The index should be >= 0 and < fileCount(). If there's no file at the index, which can happen if the archive
+         * has been reloaded since the index was found, None is returned.
+         *
+         * @param idx The 0-based index of the file.
+         *
+         * @return The codec. This is always None for layouts without compression.
+         */
+        Codec fileCodec(int idx) const noexcept;
 
         /**
          * Get a file from the archive.
          *
-         * The provided index must be >= 0 and < fileCount().
+         * The index should be >= 0 and < fileCount(). If there's no file at the index, which can happen if the archive
+         * has been reloaded since the index was found, the File is empty.
          *
          * @param idx The 0-based index of the file.
          *
@@ -286,53 +540,205 @@ namespace Id::Pack
         /**
          * Get a file from the archive.
          *
-         * The provided file name must be in the archive, as determined by has().
+         * If there's no file with the name, which can happen if the archive has been reloaded since it was found by
+         * has(), the File is empty.
          *
          * @param fileName The file to look for.
          *
          * @return A thin wrapper around the chunk of the archive that contains the file's content.
          */
-        File file(const std::string & name) const noexcept;
+        File file(std::string_view name) const noexcept;
 
         /**
-         * Extract a file from the archive to a file in the local filesystem.
+         * Read the content of a set of files into one buffer.
+         *
+         * The buffer is sized from the index and allocated from the reader's memory resource. The files are placed in it
+         * back to back, in the order given, each starting at a multiple of the alignment. Files stored next to one another
+         * in the archive are read together, with one vectored read for each run of them, straight into their places in
+         * the buffer. Compressed files are decompressed into place.
+         *
+         * The provided indices should each be >= 0 and < fileCount().
          *
-         * The provided index must be >= 0 and < fileCount().
+         * @param indices The 0-based indices of the files to read.
+         * @param alignment The alignment of each file's content in the buffer. This must be a power of 2.
+         *
+         * @return The buffer, and the content of each file in it.
+         * @throws std::runtime_error if the files can't be read, or any of them isn't in the archive (which can happen
+         * if the archive has been reloaded since the indices were found).
+         */
+        GatheredFiles gather(std::span<const int> indices, std::size_t alignment = alignof(std::max_align_t)) const;
+
+        /**
+         * Extract a file from the archive to a file in the local filesystem.
          *
          * @param idx The 0-based index of the file.
          * @param outputFile The path to which to save the extracted file locally.
+         * @throws std::runtime_error if the file isn't in the archive (which can happen if the archive has been
+         * reloaded since it was found), or can't be read.
          */
         void extract(int idx, const std::string & outputFile) const;
 
         /**
          * Extract a file from the archive to a file in the local filesystem.
          *
-         * The provided file name must be in the archive, as determined by has().
-         *
          * @param fileName The file to extract.
          * @param outputFile The path to which to save the extracted file locally.
+         * @throws std::runtime_error if the file isn't in the archive (which can happen if the archive has been
+         * reloaded since it was found), or can't be read.
          */
-        void extract(const std::string & fileName, const std::string & outputFile) const;
+        void extract(std::string_view fileName, const std::string & outputFile) const;
 
         /**
          * Extract a file from the archive and write its content to a stream.
          *
-         * The provided index must be >= 0 and < fileCount().
-         *
          * @param idx The 0-based index of the file.
          * @param out The stream to which to write the extracted file content.
+         * @throws std::runtime_error if the file isn't in the archive (which can happen if the archive has been
+         * reloaded since it was found), or can't be read.
          */
         void extract(int idx, std::ostream & out) const;
 
         /**
          * Extract a file from the archive and write its content to a stream.
          *
-         * The provided file name must be in the archive, as determined by has().
-         *
          * @param fileName The file to extract.
          * @param out The stream to which to write the extracted file content.
+         * @throws std::runtime_error if the file isn't in the archive (which can happen if the archive has been
+         * reloaded since it was found), or can't be read.
+         */
+        void extract(std::string_view fileName, std::ostream & out) const;
+
+        /**
+         * Extract all the files in the archive to a directory in the local filesystem.
+         *
+         * The archive is read sequentially on the calling thread, runs of adjacent files at a time into large
+         * page-aligned buffers, while the files are decompressed and written by a pool of worker threads. The directory
+         * tree is created before any files are written, and each file's space is preallocated before it's written. If
+         * more than one file has the same name, the last one is extracted, consistent with lookups by name.
+         *
+         * The archive is read with the Sequential hint. With dropBehind, the archive's content is also released from the
+         * page cache once it's been read, so that extracting a large archive doesn't evict other processes' working set.
+         *
+         * @param directory The directory in which to save the extracted files.
+         * @param threads The number of worker threads to use. 0 uses one per hardware thread.
+         * @param dropBehind Whether to release the archive's content from the page cache as it's read.
+         * @throws std::runtime_error if a file name would be extracted outside the directory, or a file can't be read,
+         * decompressed or written.
+         */
+        void extractAll(const std::string & directory, unsigned int threads = 0, bool dropBehind = false) const;
+
+        /**
+         * Start recording the order in which files are first accessed through file() and extract().
+         *
+         * The trace is appended to the trace file when tracing stops, or when the reader is destroyed. The reorder action
+         * of the packfile tool uses traces to lay archives out so that files loaded together are stored together.
+         *
+         * Tracing can be started and stopped while other threads are using the reader. Any trace already active is
+         * stopped and appended to its trace file.
+         *
+         * @param traceFileName The trace file to append the trace to.
+         * @throws std::runtime_error if the trace already active can't be written.
+         */
+        void startTrace(const std::string & traceFileName);
+
+        /**
+         * Stop recording accesses, and append the trace to the trace file. This does nothing if tracing isn't active.
+         *
+         * Accesses being recorded by other threads are waited for.
+         *
+         * @throws std::runtime_error if the trace file can't be written.
+         */
+        void stopTrace();
+
+        /**
+         * Set whether the index is shared with other processes reading the same archive.
+         *
+         * A shared index is parsed once, by the first reader to load it, and published to a named POSIX shared memory
+         * segment. Readers in other processes map the segment read-only instead of reading and parsing the index, so
+         * that many processes reading the same large archive hold one copy of its index between them. The segment is
+         * named for the archive's device, inode, size and modification time, so a changed archive gets a new segment.
+         * Segments are only accessible to, and only used from, the user that published them.
+         *
+         * This must be set before the index is loaded - that is, before any other method is called - and has no effect
+         * for archives read from streams. Segments persist until removeSharedIndex() is called or the system restarts.
+         */
+        void setShareIndex(bool share) noexcept
+        {
+            m_shareIndex = share;
+        }
+
+        /**
+         * Set the reader to preload small files when it loads the index.
+         *
+         * The data of every file no larger than the size limit is read into one buffer, in the order the files are
+         * stored, until the budget is spent. Files stored next to one another (or with small gaps between them) are read
+         * together, so a few large reads replace a read for each file. Preloaded files are then read from memory, and
+         * their content can be viewed without copying with File::view().
+         *
+         * This must be set before the index is loaded - that is, before any other method is called. It also applies to
+         * the index when the archive is reloaded.
+         *
+         * @param maxFileSize The largest file, by its stored size, to preload. 0 preloads nothing.
+         * @param budget The most bytes to preload, including gaps between files read together.
+         */
+        void setPreload(std::uint32_t maxFileSize, std::uint64_t budget = DefaultPreloadBudget) noexcept
+        {
+            m_preloadMaxFileSize = maxFileSize;
+            m_preloadBudget = budget;
+        }
+
+        /** @return The number of bytes of file data preloaded. This loads the index if necessary. */
+        std::uint64_t preloadedSize() const noexcept;
+
+        /** @return Whether the index in use is shared with other processes. This loads the index if necessary. */
+        bool sharesIndex() const noexcept;
+
+        /**
+         * Remove the shared index segment for the archive, if there is one. Readers already using it are unaffected.
+         */
+        void removeSharedIndex() const noexcept;
+
+        /**
+         * Reload the archive if it has changed since it was loaded.
+         *
+         * If the archive file has been replaced (for example by renaming a new archive over it) it's reopened. If it
+         * has been appended to, so that its index starts with the index already loaded, only the added entries are
+         * parsed. If it's been rewritten in place with its index where it was, it's reloaded if the index or the
+         * preloaded data differ. The new snapshot of the archive is published atomically: calls on other threads see
+         * either the old snapshot or the new one, and Files obtained before the reload stay valid. An archive that can't
+         * be read (for example because it's part-way through being written) is left as it was.
+         *
+         * File indices and names obtained before a reload refer to the snapshot they were obtained from. Every call
+         * looks them up in the snapshot current when it's made, and treats one that's no longer there as it would any
+         * other file not in the archive; use fileGeneration() to detect reloads where that matters.
+         *
+         * @return Whether the archive was reloaded, was unchanged or couldn't be read. Archives read from streams are
+         * always Unchanged.
          */
-        void extract(const std::string & fileName, std::ostream & out) const;
+        ReloadResult reload();
+
+        /**
+         * Watch the archive for changes with inotify, and reload it when it changes.
+         *
+         * The archive's directory is watched on a background thread, so archives that are replaced as well as those
+         * written in place are seen. Changes are reloaded once they've settled, so an archive being copied into place is
+         * reloaded once rather than for each write.
+         *
+         * @throws std::runtime_error if the archive is read from a stream, or its directory can't be watched.
+         */
+        void watch();
+
+        /** Stop watching the archive for changes. This does nothing if it isn't being watched. */
+        void unwatch() noexcept;
+
+        /** @return The number of times the archive has been reloaded. */
+        std::uint64_t fileGeneration() const noexcept
+        {
+            return m_generation.load(std::memory_order_acquire);
+        }
+
+        /** @return The fingerprint identifying the archive in trace files. */
+        TraceFingerprint traceFingerprint() const noexcept;
 
         /** @return an Iterator pointing to the first file in the archive. */
         Iterator begin();
@@ -352,44 +758,286 @@ namespace Id::Pack
         };
 
         /**
-         * The structure of the entry in the PACK archive's index for a single file (augmented with the 0-based index of
-         * the file within the archive, for use internally.
+         * An entry in the PACK archive's index for a single file, parsed according to the layout (augmented with the
+         * 0-based index of the file within the archive, for use internally). For layouts without compression the stored
+         * size is always the file size.
          */
         struct IndexEntry
         {
-            char fileName[56];
+            char fileName[Layout::NameLength + 1];
             std::uint32_t fileOffset;
             std::uint32_t fileSize;
+            std::uint32_t storedSize;
+            Codec codec;
             int index;
         };
 
+        /** A run of the archive held in the preloaded data. */
+        struct PreloadedRun
+        {
+            std::uint64_t offset;
+            std::uint64_t size;
+
+            /** Where the run starts in the preloaded data. */
+            std::size_t preloadedOffset;
+        };
+
+        /**
+         * A snapshot of the archive: the source it's read from, its header and its index.
+         *
+         * Snapshots are immutable once published, and reference counted: the reader holds the current snapshot, and each
+         * call in progress and each File holds the snapshot it uses. A snapshot replaced by a reload is destroyed, closing
+         * the archive it was read from if that's been replaced too, once the last of them is done with it.
+         */
+        struct Index
+        {
+            Index(std::shared_ptr<const Source> source, const Header & header, std::pmr::memory_resource * resource);
+
+            // Index instances can't be copied or moved
+            Index(const Index &) = delete;
+            Index(Index &&) = delete;
+            void operator = (const Index &) = delete;
+            void operator = (Index &&) = delete;
+            ~Index() noexcept;
+
+            /** Release the index loaded from the archive, once a shared index is in use in its place. */
+            void releaseLoadedIndex() noexcept;
+
+            /** The source from which the archive is read. Snapshots of an archive that's only been appended to share it. */
+            std::shared_ptr<const Source> source;
+
+            /** The header read from the PACK archive. */
+            Header header;
+
+            // The file indices, loaded from the archive unless a shared index is used. The by-name index holds the
+            // positions of the files in fileIndex sorted by name, with only the last file of any given name.
+            std::pmr::vector<IndexEntry> fileIndex;
+            std::pmr::vector<std::uint32_t> fileIndexByName;
+
+            // The file indices in use - either those loaded from the archive, or those in a shared index. Both are plain
+            // arrays, so that they're position-independent and can be shared between processes.
+            std::span<const IndexEntry> entries;
+            std::span<const std::uint32_t> entriesByName;
+
+            /** The XXH64 hash of the index as stored in the archive, to recognise it at the start of a longer index. */
+            std::uint64_t indexHash = 0;
+
+            // The mapping of the shared index, if one is used.
+            void * sharedIndex = nullptr;
+            std::size_t sharedIndexSize = 0;
+
+            // The preloaded file data, and the runs of the archive it holds, in offset order.
+            std::pmr::vector<char> preloaded;
+            std::pmr::vector<PreloadedRun> preloadedRuns;
+        };
+
         /**
          * Internal constructor to which all other constructors delegate.
          *
-         * @param in The stream from which the archive is being read.
-         * @param owned Whether or not the stream pointer is owned by the Reader instance.
+         * @param source The source from which the archive is being read.
+         * @param fileName The path of the archive, if it's read from a file.
+         * @param resource The memory resource from which to allocate the index.
+         */
+        BasicReader(std::shared_ptr<const Source> source, std::string fileName, std::pmr::memory_resource * resource);
+
+        /**
+         * Read the header of a PACK archive.
+         *
+         * @throws std::runtime_error if the source is not an archive with the reader's layout.
          */
-        Reader(std::istream * in, bool owned);
+        static Header readHeader(const Source & source);
 
-        /** Lazy-load the file index from the PACK archive. */
+        /** Preload the small files in a snapshot, as set by setPreload(). */
+        void preload(Index & index) const noexcept;
+
+        /**
+         * Check whether the archive still holds the index and preloaded data of a snapshot of the same file, so that
+         * rewriting it in place without moving its index is noticed.
+         */
+        bool matches(const Index & index) const noexcept;
+
+        /** Record an access to a file in the active trace, if there is one. */
+        void traceAccess(int idx) const noexcept;
+
+        /** Append a trace that's no longer active to its trace file, once no thread is recording in it, and destroy it. */
+        void retireTrace(AccessTrace * trace) const;
+
+        /** @return The preloaded data of a file, or nullptr if it wasn't preloaded. */
+        static const char * preloadedData(const Index & index, const IndexEntry & entry) noexcept;
+
+        /**
+         * Lazy-load the file index, from a shared index if sharing is enabled and one is available, otherwise from the
+         * PACK archive. This is safe to call from several threads at once.
+         */
         void ensureIndex() const noexcept;
 
-        /** The input stream from which the archive is being read. */
-        std::istream * m_inStream;
+        /** @return The current snapshot of the archive. Its entries are only valid once ensureIndex() has been called. */
+        std::shared_ptr<const Index> current() const noexcept
+        {
+            std::lock_guard lock(m_indexMutex);
+            return m_index;
+        }
+
+        /** @return The source of a snapshot, sharing ownership of the snapshot so that it outlives a reload. */
+        static std::shared_ptr<const Source> fileSource(std::shared_ptr<const Index> index) noexcept
+        {
+            const auto * source = index->source.get();
+            return {std::move(index), source};
+        }
+
+        /**
+         * Load a snapshot's index, from a shared index if sharing is enabled and one is available, otherwise from the
+         * PACK archive.
+         *
+         * @param previous The previous snapshot of the same file, if there is one. If the archive has only been appended
+         * to, the entries it holds are reused rather than parsed again.
+         * @return Whether the index could be loaded.
+         */
+        bool loadIndex(Index & index, const Index * previous) const noexcept;
+
+        /**
+         * Read a snapshot's file index from the PACK archive into its fileIndex and fileIndexByName.
+         *
+         * @return Whether the index could be read. An index with an entry whose codec isn't recognised, or with an
+         * uncompressed entry whose stored size isn't its size, is not read.
+         */
+        bool readIndex(Index & index, const Index * previous) const noexcept;
+
+        /** @return The name of the shared memory segment for a snapshot's index, or empty if it can't be shared. */
+        std::string sharedIndexName(const Index & index) const noexcept;
+
+        /**
+         * Attach a snapshot to a published shared index.
+         *
+         * @return Whether the segment holds a complete index for the archive, and is now in use.
+         */
+        bool attachSharedIndex(Index & index, const std::string & segmentName) const noexcept;
+
+        /**
+         * Remove a shared index segment that can't be attached and that no process is still publishing.
+         *
+         * @return Whether the segment has been removed, so that it can be created again.
+         */
+        bool reclaimSharedIndex(const std::string & segmentName) const noexcept;
+
+        /**
+         * Publish a snapshot's loaded index to a shared memory segment, and use it in place of the private copy. If the
+         * segment is still being published by another process, or can't be created, the private copy remains in use.
+         */
+        void publishSharedIndex(Index & index, const std::string & segmentName) const noexcept;
+
+        /** Fetch the index entry in a snapshot for a named file, or nullptr if there's no file with the name. */
+        static const IndexEntry * findEntry(const Index & index, std::string_view fileName) noexcept;
+
+        /** Fetch the index entry in a snapshot for a file's position, or nullptr if there's no file at the position. */
+        static const IndexEntry * entryAt(const Index & index, int idx) noexcept;
+
+        /** Provide a File for an entry in a snapshot, or an empty File if there's no entry. */
+        File openFile(std::shared_ptr<const Index> index, const IndexEntry * entry) const noexcept;
+
+        /**
+         * Watch the archive's directory for changes to the archive, reloading it as they settle.
+         *
+         * The watcher closes the inotify descriptor when it stops. The wake descriptor is closed by unwatch().
+         */
+        void watchArchive(std::stop_token stopToken, int inotifyFd, int wakeFd) noexcept;
+
+        /** The absolute path of the archive, or empty if it's read from a stream. */
+        std::string m_fileName;
+
+        /** The memory resource from which indices are allocated. */
+        std::pmr::memory_resource * m_resource;
+
+        /** Ensures the index is loaded only once. */
+        mutable std::once_flag m_indexLoaded;
+
+        // The largest file to preload, and the most bytes to preload.
+        std::uint32_t m_preloadMaxFileSize = 0;
+        std::uint64_t m_preloadBudget = 0;
+
+        /** Whether the index is shared with other processes. */
+        bool m_shareIndex = false;
+
+        /** The current snapshot of the archive. Until the index is loaded, only ensureIndex() may modify it. */
+        std::shared_ptr<Index> m_index;
+
+        /**
+         * Guards the current snapshot, which is only held long enough to copy or replace the pointer. (libstdc++'s
+         * std::atomic<std::shared_ptr> releases its lock without ordering the read of the pointer before it.)
+         */
+        mutable std::mutex m_indexMutex;
+
+        /** Serialises reloads. */
+        mutable std::mutex m_reloadMutex;
+
+        /** The number of times the archive has been reloaded. */
+        std::atomic<std::uint64_t> m_generation = 0;
 
-        /** Whether the Reader object owns the stream pointer, and will delete it on destruction. */
-        bool m_ownedStream;
+        /** The thread watching the archive for changes, and the eventfd that wakes it to stop. */
+        std::jthread m_watcher;
+        int m_watcherWakeFd = -1;
 
-        /** The header read from the PACK archive stream. */
-        Header m_header;
+        /** The trace recording accesses, if tracing is active. It's owned by the reader. */
+        std::atomic<AccessTrace *> m_trace = nullptr;
 
-        // The file indices, lazy-loaded on-demanded by ensureIndex()
-        mutable std::map<std::string, IndexEntry> m_fileIndexByName;
-        mutable std::vector<IndexEntry> m_fileIndex;
+        /** The number of threads recording an access, which a trace must wait for before it's destroyed. */
+        mutable std::atomic<int> m_traceUsers = 0;
     };
 
-    /** Output a File from a PACK archive to an output stream. */
-    std::ostream & operator<<(std::ostream & out, const Reader::File & file) noexcept;
+    extern template class BasicReader<PackLayout>;
+    extern template class BasicReader<SinLayout>;
+    extern template class BasicReader<DaikatanaLayout>;
+    extern template class BasicReader<ExtendedLayout>;
+
+    /** Reads Quake PACK archives. */
+    using Reader = BasicReader<PackLayout>;
+
+    /** Reads SiN SPAK archives. */
+    using SinReader = BasicReader<SinLayout>;
+
+    /** Reads Daikatana PACK archives. */
+    using DaikatanaReader = BasicReader<DaikatanaLayout>;
+
+    /** Reads extended PAKX archives. */
+    using ExtendedReader = BasicReader<ExtendedLayout>;
+
+    /**
+     * Read the four-byte format identifier from the start of a file.
+     *
+     * @return The identifier, or an empty string if the file can't be read.
+     */
+    std::string formatId(const std::string & fileName);
+
+    /**
+     * Open an archive with the reader for its format, and pass the reader to a visitor.
+     *
+     * The format is detected from the header identifier. Archives identified as "PACK" are read as Quake archives -
+     * Daikatana archives can't be distinguished by their header and must be opened with DaikatanaReader.
+     *
+     * @param fileName The archive to open.
+     * @param visitor A callable accepting a reference to any of the readers, returning the same type for each.
+     *
+     * @return Whatever the visitor returns.
+     * @throws std::runtime_error if the file is not a recognised archive.
+     */
+    template<class Visitor>
+    decltype(auto) withReader(const std::string & fileName, Visitor && visitor)
+    {
+        const auto id = formatId(fileName);
+
+        if (SinLayout::Id == id) {
+            SinReader reader(fileName);
+            return visitor(reader);
+        }
+
+        if (ExtendedLayout::Id == id) {
+            ExtendedReader reader(fileName);
+            return visitor(reader);
+        }
+
+        Reader reader(fileName);
+        return visitor(reader);
+    }
 }
 
 #endif
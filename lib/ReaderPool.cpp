@@ -0,0 +1,232 @@
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <sys/stat.h>
+#include "ReaderPool.h"
+
+using namespace Id::Pack;
+
+
+namespace
+{
+    /** @return The modification time of a file, in nanoseconds. */
+    std::int64_t modificationTime(const struct stat & info) noexcept
+    {
+        return static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1'000'000'000 + info.st_mtim.tv_nsec;
+    }
+}
+
+
+template<class Layout>
+BasicReaderPool<Layout> & BasicReaderPool<Layout>::global()
+{
+    // deliberately leaked, so that it outlives every handle whatever the order of static destruction
+    static auto * pool = new BasicReaderPool();
+    return *pool;
+}
+
+
+template<class Layout>
+typename BasicReaderPool<Layout>::Handle BasicReaderPool<Layout>::open(const std::string & fileName)
+{
+    struct stat info{};
+
+    if (0 != ::stat(fileName.c_str(), &info)) {
+        throw std::runtime_error(std::format(R"(Error opening "{}": {})", fileName, std::strerror(errno)));
+    }
+
+    Entry * changed = nullptr;
+    Handle handle;
+
+    {
+        std::lock_guard lock(m_mutex);
+
+        if (const auto found = m_entries.find({static_cast<std::uint64_t>(info.st_dev), static_cast<std::uint64_t>(info.st_ino)}); m_entries.end() != found) {
+            auto & entry = *found->second;
+
+            if (entry.size != info.st_size || entry.modified != modificationTime(info)) {
+                changed = &entry;
+            }
+
+            handle = acquire(entry);
+        }
+    }
+
+    // the archive has been written to in place since it was last opened. The handle keeps the entry alive, and if the
+    // reader no longer reads the archive once it's reloaded, the handle is released and the archive opened afresh
+    if (handle && (!changed || reload(*changed, info.st_size, modificationTime(info)))) {
+        return handle;
+    }
+
+    handle.reset();
+
+    // the archive is opened without the pool locked, and identified by the file actually opened, in case the path now
+    // refers to a different file
+    auto reader = std::make_shared<ReaderType>(fileName);
+
+    if (0 != ::fstat(reader->source()->fileDescriptor(), &info)) {
+        throw std::runtime_error(std::format(R"(Error opening "{}": {})", fileName, std::strerror(errno)));
+    }
+
+    const Key key = {static_cast<std::uint64_t>(info.st_dev), static_cast<std::uint64_t>(info.st_ino)};
+    std::lock_guard lock(m_mutex);
+    auto & inserted = m_entries[key];
+
+    // another thread may have opened the same archive meanwhile, in which case its reader is shared and this one closed
+    if (!inserted) {
+        inserted = std::make_unique<Entry>();
+        inserted->key = key;
+        inserted->reader = std::move(reader);
+        inserted->size = info.st_size;
+        inserted->modified = modificationTime(info);
+    }
+
+    return acquire(*inserted);
+}
+
+
+template<class Layout>
+bool BasicReaderPool<Layout>::reload(Entry & entry, std::int64_t size, std::int64_t modified)
+{
+    const auto result = entry.reader->reload();
+
+    // the reader reopens the archive by the path it was first opened with, which may now be another file
+    struct stat info{};
+    const auto sameFile = (0 == ::fstat(entry.reader->source()->fileDescriptor(), &info)
+                           && entry.key == Key{static_cast<std::uint64_t>(info.st_dev), static_cast<std::uint64_t>(info.st_ino)});
+
+    std::lock_guard lock(m_mutex);
+
+    if (!sameFile) {
+        if (!entry.isDetached) {
+            // the handle being released will close the reader if it's the last one
+            const auto found = m_entries.find(entry.key);
+            m_detached.push_back(std::move(found->second));
+            m_entries.erase(found);
+            entry.isDetached = true;
+        }
+
+        return false;
+    }
+
+    // a reload that failed is tried again the next time the archive is opened
+    if (ReloadResult::Failed != result) {
+        entry.size = size;
+        entry.modified = modified;
+    }
+
+    return true;
+}
+
+
+template<class Layout>
+typename BasicReaderPool<Layout>::Handle BasicReaderPool<Layout>::acquire(Entry & entry)
+{
+    if (entry.isIdle) {
+        m_idle.erase(entry.idle);
+        entry.isIdle = false;
+    }
+
+    // the handle shares nothing with the reader's own ownership; releasing it only tells the pool
+    Handle handle(entry.reader.get(), [this, &entry](const ReaderType *) { release(entry); });
+    ++entry.users;
+    return handle;
+}
+
+
+template<class Layout>
+void BasicReaderPool<Layout>::release(Entry & entry) noexcept
+{
+    std::vector<std::shared_ptr<ReaderType>> closed;
+
+    {
+        std::lock_guard lock(m_mutex);
+
+        if (0 < --entry.users) {
+            return;
+        }
+
+        if (entry.isDetached) {
+            closed.push_back(std::move(entry.reader));
+            std::erase_if(m_detached, [&entry](const std::unique_ptr<Entry> & detached) { return &entry == detached.get(); });
+            return;
+        }
+
+        try {
+            entry.idle = m_idle.insert(m_idle.end(), entry.key);
+            entry.isIdle = true;
+            closed = trimIdle(m_maxIdle);
+        } catch (const std::bad_alloc &) {
+            // an entry that can't be listed as idle is closed straight away
+            closed.push_back(std::move(entry.reader));
+            m_entries.erase(entry.key);
+        }
+    }
+
+    // the readers are closed here, with the pool unlocked
+}
+
+
+template<class Layout>
+std::vector<std::shared_ptr<typename BasicReaderPool<Layout>::ReaderType>> BasicReaderPool<Layout>::trimIdle(std::size_t maxIdle)
+{
+    std::vector<std::shared_ptr<ReaderType>> closed;
+
+    while (m_idle.size() > maxIdle) {
+        const auto found = m_entries.find(m_idle.front());
+        closed.push_back(std::move(found->second->reader));
+        m_entries.erase(found);
+        m_idle.pop_front();
+    }
+
+    return closed;
+}
+
+
+template<class Layout>
+std::size_t BasicReaderPool<Layout>::openCount() const noexcept
+{
+    std::lock_guard lock(m_mutex);
+    return m_entries.size() + m_detached.size();
+}
+
+
+template<class Layout>
+std::size_t BasicReaderPool<Layout>::idleCount() const noexcept
+{
+    std::lock_guard lock(m_mutex);
+    return m_idle.size();
+}
+
+
+template<class Layout>
+void BasicReaderPool<Layout>::setMaxIdle(std::size_t maxIdle)
+{
+    std::vector<std::shared_ptr<ReaderType>> closed;
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_maxIdle = maxIdle;
+        closed = trimIdle(maxIdle);
+    }
+
+    // the readers are closed here, with the pool unlocked
+}
+
+
+template<class Layout>
+void BasicReaderPool<Layout>::clear()
+{
+    std::vector<std::shared_ptr<ReaderType>> closed;
+
+    {
+        std::lock_guard lock(m_mutex);
+        closed = trimIdle(0);
+    }
+}
+
+
+template class Id::Pack::BasicReaderPool<PackLayout>;
+template class Id::Pack::BasicReaderPool<SinLayout>;
+template class Id::Pack::BasicReaderPool<DaikatanaLayout>;
+template class Id::Pack::BasicReaderPool<ExtendedLayout>;
@@ -0,0 +1,197 @@
+#ifndef LIBIDPAK_READERPOOL_H
+#define LIBIDPAK_READERPOOL_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Reader.h"
+
+namespace Id::Pack
+{
+    /**
+     * Shares readers between the users of the same archives, for services that open archives for each request.
+     *
+     * Opening an archive through a pool returns a handle to the one reader for that archive, so its users share its
+     * file descriptor and its parsed index. Archives are identified by device and inode, so different paths to the same
+     * archive share a reader and an archive replaced by another file gets a new one. An archive that's changed in place
+     * since it was last opened is reloaded, and reloaded again the next time it's opened if that fails. A reader that
+     * reads another file once it's reloaded (because the path it was opened by has been replaced) is no longer shared,
+     * and the archive is opened afresh.
+     *
+     * A reader is kept while any handle to it exists. When the last handle is released, the reader stays open as an idle
+     * reader, ready to be used again without reopening the archive, until the pool holds more idle readers than its
+     * limit - then the least recently used are closed.
+     *
+     * Pools are safe to use from several threads at once, and the readers they provide can be used from several threads
+     * at once. A pool must outlive the handles it provides.
+     */
+    template<class Layout>
+    class BasicReaderPool
+    {
+    public:
+        /** The type of reader the pool provides. */
+        using ReaderType = BasicReader<Layout>;
+
+        /** A handle to a reader. The reader stays open at least as long as the handle. */
+        using Handle = std::shared_ptr<const ReaderType>;
+
+        /** The default number of idle readers a pool keeps open. */
+        static constexpr std::size_t DefaultMaxIdle = 64;
+
+        /**
+         * @param maxIdle The most readers to keep open with no handles to them.
+         */
+        explicit BasicReaderPool(std::size_t maxIdle = DefaultMaxIdle) noexcept
+        : m_maxIdle(maxIdle)
+        {}
+
+        // BasicReaderPool instances can't be copied or moved
+        BasicReaderPool(const BasicReaderPool &) = delete;
+        BasicReaderPool(BasicReaderPool &&) = delete;
+        void operator = (const BasicReaderPool &) = delete;
+        void operator = (BasicReaderPool &&) = delete;
+        ~BasicReaderPool() noexcept = default;
+
+        /**
+         * The pool shared by the whole process.
+         *
+         * It's never destroyed, so the handles it provides can be released at any time, including during static
+         * destruction.
+         */
+        static BasicReaderPool & global();
+
+        /**
+         * Open an archive, or share the reader already open for it.
+         *
+         * @param fileName The archive to open.
+         *
+         * @return A handle to the reader for the archive.
+         * @throws std::runtime_error if the file can't be opened or is not an archive with the pool's layout.
+         */
+        Handle open(const std::string & fileName);
+
+        /** @return The number of readers open, in use or idle. */
+        std::size_t openCount() const noexcept;
+
+        /** @return The number of idle readers open. */
+        std::size_t idleCount() const noexcept;
+
+        /**
+         * Set the most readers to keep open with no handles to them. Any more idle readers than this are closed, least
+         * recently used first.
+         */
+        void setMaxIdle(std::size_t maxIdle);
+
+        /** Close all the idle readers. Readers in use are unaffected. */
+        void clear();
+
+    private:
+        /** Identifies an archive by the file it's read from. */
+        struct Key
+        {
+            std::uint64_t device;
+            std::uint64_t inode;
+
+            bool operator==(const Key &) const noexcept = default;
+        };
+
+        struct KeyHash
+        {
+            std::size_t operator()(const Key & key) const noexcept
+            {
+                return std::hash<std::uint64_t>{}(key.device * 0x9e3779b97f4a7c15 ^ key.inode);
+            }
+        };
+
+        /** An open archive. */
+        struct Entry
+        {
+            /** The archive the entry is for, under which it's listed unless it's been detached. */
+            Key key;
+
+            std::shared_ptr<ReaderType> reader;
+
+            /** The number of handles to the reader. */
+            std::size_t users = 0;
+
+            // The size and modification time of the archive when it was last loaded, to notice changes in place.
+            std::int64_t size = 0;
+            std::int64_t modified = 0;
+
+            // Whether the reader is idle, and if so its position in the idle list.
+            bool isIdle = false;
+            typename std::list<Key>::iterator idle;
+
+            /** Whether the reader no longer reads the archive, and is to be closed when its last handle is released. */
+            bool isDetached = false;
+        };
+
+        /**
+         * Provide a handle to an entry's reader.
+         *
+         * The pool must be locked.
+         */
+        Handle acquire(Entry & entry);
+
+        /**
+         * Release a handle to an entry's reader, leaving the reader idle if it was the last handle (or closing it if the
+         * entry has been detached).
+         */
+        void release(Entry & entry) noexcept;
+
+        /**
+         * Reload the reader of an archive that's changed since it was last opened.
+         *
+         * @param entry The entry for the archive, to which the caller holds a handle.
+         * @param size The size of the archive, by which it was found to have changed.
+         * @param modified The modification time of the archive, by which it was found to have changed.
+         * @return Whether the reader still reads the archive. If it doesn't, the entry has been detached.
+         */
+        bool reload(Entry & entry, std::int64_t size, std::int64_t modified);
+
+        /**
+         * Close the least recently used idle readers until no more than a number remain.
+         *
+         * The pool must be locked. The readers are returned so that they can be closed once it's unlocked.
+         */
+        std::vector<std::shared_ptr<ReaderType>> trimIdle(std::size_t maxIdle);
+
+        /** The most idle readers to keep open. */
+        std::size_t m_maxIdle;
+
+        /** The open archives. Entries are allocated individually, so that handles can refer to them wherever they're held. */
+        std::unordered_map<Key, std::unique_ptr<Entry>, KeyHash> m_entries;
+
+        /** The entries detached from their archives that still have handles. */
+        std::vector<std::unique_ptr<Entry>> m_detached;
+
+        /** The idle archives, least recently used first. */
+        std::list<Key> m_idle;
+
+        /** Guards the entries and the idle list. */
+        mutable std::mutex m_mutex;
+    };
+
+    extern template class BasicReaderPool<PackLayout>;
+    extern template class BasicReaderPool<SinLayout>;
+    extern template class BasicReaderPool<DaikatanaLayout>;
+    extern template class BasicReaderPool<ExtendedLayout>;
+
+    /** Shares Quake PACK archive readers. */
+    using ReaderPool = BasicReaderPool<PackLayout>;
+
+    /** Shares SiN SPAK archive readers. */
+    using SinReaderPool = BasicReaderPool<SinLayout>;
+
+    /** Shares Daikatana PACK archive readers. */
+    using DaikatanaReaderPool = BasicReaderPool<DaikatanaLayout>;
+
+    /** Shares extended PAKX archive readers. */
+    using ExtendedReaderPool = BasicReaderPool<ExtendedLayout>;
+}
+
+#endif
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <format>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+#include "Source.h"
+
+using namespace Id::Pack;
+
+
+void Source::readScattered(std::uint64_t offset, std::span<const std::span<char>> buffers) const
+{
+    for (const auto buffer : buffers) {
+        read(offset, buffer.data(), buffer.size());
+        offset += buffer.size();
+    }
+}
+
+
+FileSource::FileSource(const std::string & fileName)
+: m_fd(::open(fileName.c_str(), O_RDONLY | O_CLOEXEC))
+{
+    if (0 > m_fd) {
+        throw std::runtime_error(std::format(R"(Error opening "{}": {})", fileName, std::strerror(errno)));
+    }
+}
+
+
+FileSource::~FileSource() noexcept
+{
+    ::close(m_fd);
+}
+
+
+std::uint64_t FileSource::size() const
+{
+    struct stat info{};
+
+    if (0 != ::fstat(m_fd, &info)) {
+        throw std::runtime_error(std::format("Error determining archive size: {}", std::strerror(errno)));
+    }
+
+    return static_cast<std::uint64_t>(info.st_size);
+}
+
+
+void FileSource::read(std::uint64_t offset, char * data, std::size_t size) const
+{
+    while (0 < size) {
+        const auto bytesRead = ::pread(m_fd, data, size, static_cast<off_t>(offset));
+
+        if (0 > bytesRead) {
+            if (EINTR == errno) {
+                continue;
+            }
+
+            throw std::runtime_error(std::format("Error reading archive: {}", std::strerror(errno)));
+        }
+
+        if (0 == bytesRead) {
+            throw std::runtime_error("Error reading archive: unexpected end of file");
+        }
+
+        data += bytesRead;
+        offset += bytesRead;
+        size -= bytesRead;
+    }
+}
+
+
+void FileSource::readScattered(std::uint64_t offset, std::span<const std::span<char>> buffers) const
+{
+    std::vector<iovec> vectors;
+    vectors.reserve(buffers.size());
+
+    for (const auto buffer : buffers) {
+        if (!buffer.empty()) {
+            vectors.push_back({buffer.data(), buffer.size()});
+        }
+    }
+
+    auto remaining = std::span(vectors);
+
+    while (!remaining.empty()) {
+        const auto bytesRead = ::preadv(m_fd, remaining.data(), static_cast<int>(std::min<std::size_t>(remaining.size(), IOV_MAX)), static_cast<off_t>(offset));
+
+        if (0 > bytesRead) {
+            if (EINTR == errno) {
+                continue;
+            }
+
+            throw std::runtime_error(std::format("Error reading archive: {}", std::strerror(errno)));
+        }
+
+        if (0 == bytesRead) {
+            throw std::runtime_error("Error reading archive: unexpected end of file");
+        }
+
+        offset += bytesRead;
+
+        // skip the buffers filled, and trim the one partly filled
+        for (auto bytes = static_cast<std::size_t>(bytesRead); 0 < bytes;) {
+            auto & vector = remaining.front();
+
+            if (bytes < vector.iov_len) {
+                vector.iov_base = static_cast<char *>(vector.iov_base) + bytes;
+                vector.iov_len -= bytes;
+                break;
+            }
+
+            bytes -= vector.iov_len;
+            remaining = remaining.subspan(1);
+        }
+    }
+}
+
+
+void FileSource::advise(std::uint64_t offset, std::uint64_t size, AccessHint hint) const noexcept
+{
+    int advice = POSIX_FADV_NORMAL;
+
+    switch (hint) {
+        case AccessHint::Normal:
+            break;
+
+        case AccessHint::Sequential:
+            advice = POSIX_FADV_SEQUENTIAL;
+            break;
+
+        case AccessHint::Random:
+            advice = POSIX_FADV_RANDOM;
+            break;
+
+        case AccessHint::WillNeed:
+            advice = POSIX_FADV_WILLNEED;
+            break;
+
+        case AccessHint::DontNeed:
+            advice = POSIX_FADV_DONTNEED;
+            break;
+    }
+
+    ::posix_fadvise(m_fd, static_cast<off_t>(offset), static_cast<off_t>(size), advice);
+}
+
+
+std::uint64_t StreamSource::size() const
+{
+    std::lock_guard lock(m_mutex);
+    m_inStream.clear();
+    m_inStream.seekg(0, std::ios::end);
+    const auto size = m_inStream.tellg();
+
+    if (0 > size) {
+        throw std::runtime_error("Error determining archive size");
+    }
+
+    return static_cast<std::uint64_t>(size);
+}
+
+
+void StreamSource::read(std::uint64_t offset, char * data, std::size_t size) const
+{
+    std::lock_guard lock(m_mutex);
+
+    // other readers of the stream may have left it in a failed state, or moved the read position
+    m_inStream.clear();
+    m_inStream.seekg(static_cast<std::streamoff>(offset));
+    m_inStream.read(data, static_cast<std::streamsize>(size));
+
+    if (m_inStream.fail()) {
+        m_inStream.clear();
+        throw std::runtime_error("Error reading archive");
+    }
+}
@@ -0,0 +1,156 @@
+#ifndef LIBIDPAK_SOURCE_H
+#define LIBIDPAK_SOURCE_H
+
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <span>
+#include <string>
+
+namespace Id::Pack
+{
+    /**
+     * Hints to the OS about how part of an archive is about to be accessed, so it can read ahead or cache accordingly.
+     */
+    enum class AccessHint
+    {
+        /** No particular pattern - the OS default. */
+        Normal,
+
+        /** The content will be read once, in order, so it's worth reading well ahead. */
+        Sequential,
+
+        /** The content will be read in small pieces in no particular order, so reading ahead is wasted. */
+        Random,
+
+        /** The content will be read soon, so it's worth starting to read it into the page cache now. */
+        WillNeed,
+
+        /** The content won't be read again soon, so it needn't occupy the page cache. */
+        DontNeed,
+    };
+
+    /**
+     * The storage from which an archive is read.
+     *
+     * Reads are positional, so a source can be shared by all the Files a reader yields, and read from by several threads
+     * at once.
+     */
+    class Source
+    {
+    public:
+        virtual ~Source() noexcept = default;
+
+        /**
+         * @return The size in bytes of the archive.
+         * @throws std::runtime_error if the size can't be determined.
+         */
+        virtual std::uint64_t size() const = 0;
+
+        /**
+         * Read bytes from the archive.
+         *
+         * @param offset The byte offset in the archive from which to read.
+         * @param data The buffer into which to read.
+         * @param size The number of bytes to read.
+         * @throws std::runtime_error if the requested bytes can't all be read.
+         */
+        virtual void read(std::uint64_t offset, char * data, std::size_t size) const = 0;
+
+        /**
+         * Read a contiguous range of the archive into several buffers, filling each in turn.
+         *
+         * By default each buffer is filled with a separate read().
+         *
+         * @param offset The byte offset in the archive from which to read.
+         * @param buffers The buffers into which to read. The range read is as long as the buffers put together.
+         * @throws std::runtime_error if the requested bytes can't all be read.
+         */
+        virtual void readScattered(std::uint64_t offset, std::span<const std::span<char>> buffers) const;
+
+        /** @return The file descriptor the source reads from, or -1 if it doesn't read from a file descriptor. */
+        virtual int fileDescriptor() const noexcept
+        {
+            return -1;
+        }
+
+        /**
+         * Advise the OS how a range of the archive is about to be accessed.
+         *
+         * Hints only affect performance, so sources that can't pass them on ignore them. For DontNeed, pages only partly
+         * within the range are kept.
+         *
+         * @param offset The byte offset in the archive of the start of the range.
+         * @param size The byte size of the range. 0 extends the range to the end of the archive.
+         * @param hint How the range will be accessed.
+         */
+        virtual void advise(std::uint64_t, std::uint64_t, AccessHint) const noexcept
+        {
+        }
+    };
+
+    /**
+     * A source that reads a file in the local filesystem using positional reads (pread()), which need no locking.
+     */
+    class FileSource : public Source
+    {
+    public:
+        /**
+         * @param fileName The file to read.
+         * @throws std::runtime_error if the file can't be opened.
+         */
+        explicit FileSource(const std::string & fileName);
+
+        // FileSource instances can't be copied or moved
+        FileSource(const FileSource &) = delete;
+        FileSource(FileSource &&) = delete;
+        void operator = (const FileSource &) = delete;
+        void operator = (FileSource &&) = delete;
+        ~FileSource() noexcept override;
+
+        std::uint64_t size() const override;
+        void read(std::uint64_t offset, char * data, std::size_t size) const override;
+
+        /** The buffers are filled with vectored reads (preadv()). */
+        void readScattered(std::uint64_t offset, std::span<const std::span<char>> buffers) const override;
+
+        int fileDescriptor() const noexcept override
+        {
+            return m_fd;
+        }
+
+        /** Hints are passed on with posix_fadvise(). */
+        void advise(std::uint64_t offset, std::uint64_t size, AccessHint hint) const noexcept override;
+
+    private:
+        /** The file descriptor for the open file. */
+        int m_fd;
+    };
+
+    /**
+     * A source that reads from a stream, serialising access to it.
+     */
+    class StreamSource : public Source
+    {
+    public:
+        /**
+         * @param stream The stream to read from. The caller is responsible for ensuring the stream lives as long as the
+         * source.
+         */
+        explicit StreamSource(std::istream & stream) noexcept
+        : m_inStream(stream)
+        {}
+
+        std::uint64_t size() const override;
+        void read(std::uint64_t offset, char * data, std::size_t size) const override;
+
+    private:
+        /** The stream from which the archive is read. */
+        std::istream & m_inStream;
+
+        /** Serialises access to the stream, whose read position is shared. */
+        mutable std::mutex m_mutex;
+    };
+}
+
+#endif
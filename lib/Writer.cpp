@@ -0,0 +1,338 @@
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include "Hash.h"
+#include "Writer.h"
+
+using namespace Id::Pack;
+
+
+namespace
+{
+    /** The byte size of the header of a PACK archive. */
+    constexpr std::size_t HeaderSize = 12;
+
+    template<std::integral T>
+    T nativeToLittle(const T value) requires (std::endian::native != std::endian::little)
+    {
+        return std::byteswap(value);
+    }
+
+    template<std::integral T>
+    T nativeToLittle(const T value) requires (std::endian::native == std::endian::little)
+    {
+        return value;
+    }
+
+    void writeUint32(char * bytes, std::uint32_t value)
+    {
+        value = nativeToLittle(value);
+        std::memcpy(bytes, &value, sizeof(value));
+    }
+}
+
+
+template<class Layout>
+BasicWriter<Layout>::BasicWriter(const std::string & fileName)
+: BasicWriter(new std::fstream(fileName, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary), true)
+{
+    m_fileName = fileName;
+}
+
+
+template<class Layout>
+BasicWriter<Layout>::BasicWriter(std::iostream & stream)
+: BasicWriter(&stream, false)
+{}
+
+
+template<class Layout>
+BasicWriter<Layout>::BasicWriter(std::iostream * out, bool owned)
+: m_outStream(out),
+  m_ownedStream(owned),
+  m_uncaughtExceptions(std::uncaught_exceptions()),
+  m_dataEnd(HeaderSize)
+{
+    assert(nullptr != out);
+
+    // the header is written properly once the index is complete
+    std::array<char, HeaderSize> header{};
+    out->seekp(0);
+    out->write(header.data(), HeaderSize);
+
+    if (out->fail()) {
+        if (m_ownedStream) {
+            delete m_outStream;
+        }
+
+        throw std::runtime_error("Error writing PACK archive header");
+    }
+}
+
+
+template<class Layout>
+BasicWriter<Layout>::~BasicWriter() noexcept
+{
+    // a writer destroyed by an exception must not leave a valid-looking archive behind, so the index is not written
+    const auto abandoned = !m_finished && std::uncaught_exceptions() > m_uncaughtExceptions;
+
+    if (!m_finished && !abandoned) {
+        try {
+            finish();
+        } catch (const std::runtime_error &) {
+        }
+    }
+
+    if (m_ownedStream) {
+        delete m_outStream;
+    }
+
+    m_outStream = nullptr;
+
+    if (abandoned && !m_fileName.empty()) {
+        std::error_code err;
+        std::filesystem::remove(m_fileName, err);
+    }
+}
+
+
+template<class Layout>
+std::string BasicWriter<Layout>::readStored(std::uint32_t offset, std::uint32_t size)
+{
+    std::string stored(size, 0);
+    m_outStream->seekg(offset);
+    m_outStream->read(stored.data(), size);
+
+    if (m_outStream->fail()) {
+        throw std::runtime_error("Error reading back content from PACK archive");
+    }
+
+    return stored;
+}
+
+
+template<class Layout>
+const typename BasicWriter<Layout>::Blob * BasicWriter<Layout>::findBlob(std::string_view stored, Codec codec, std::uint32_t fileSize, std::optional<std::uint64_t> & hash)
+{
+    const auto bucket = m_blobsBySize.find(static_cast<std::uint32_t>(stored.size()));
+
+    if (bucket == m_blobsBySize.end()) {
+        return nullptr;
+    }
+
+    hash = xxh64(stored);
+
+    for (auto & blob : bucket->second) {
+        if (blob.codec != codec || blob.fileSize != fileSize) {
+            continue;
+        }
+
+        std::optional<std::string> existing;
+
+        if (!blob.hash) {
+            existing = readStored(blob.fileOffset, static_cast<std::uint32_t>(stored.size()));
+            blob.hash = xxh64(*existing);
+        }
+
+        if (*blob.hash != *hash) {
+            continue;
+        }
+
+        if (!existing) {
+            existing = readStored(blob.fileOffset, static_cast<std::uint32_t>(stored.size()));
+        }
+
+        if (*existing == stored) {
+            return &blob;
+        }
+    }
+
+    return nullptr;
+}
+
+
+template<class Layout>
+const typename BasicWriter<Layout>::CompressedBlob * BasicWriter<Layout>::findCompressedBlob(std::string_view content, std::uint64_t contentHash, Codec codec)
+{
+    const auto [begin, end] = m_compressedBlobsByContent.equal_range(contentHash);
+
+    for (auto blob = begin; blob != end; ++blob) {
+        if (blob->second.codec != codec || blob->second.fileSize != content.size()) {
+            continue;
+        }
+
+        // decompressing to confirm the match is far cheaper than compressing
+        if (decompress(codec, readStored(blob->second.fileOffset, blob->second.storedSize), content.size()) == content) {
+            return &blob->second;
+        }
+    }
+
+    return nullptr;
+}
+
+
+template<class Layout>
+void BasicWriter<Layout>::checkEntry(const std::string & fileName, std::size_t size, Codec codec) const
+{
+    if (fileName.empty() || Layout::NameLength < fileName.size()) {
+        throw std::runtime_error(std::format("File name \"{}\" must be between 1 and {} bytes long", fileName, Layout::NameLength));
+    }
+
+    if constexpr (Layout::Compressed) {
+        if (!Layout::supports(codec)) {
+            throw std::runtime_error(std::format("The {} codec can't be used in archives with ID \"{}\"", codecName(codec), Layout::Id));
+        }
+    } else if (Codec::None != codec) {
+        throw std::runtime_error(std::format("Archives with ID \"{}\" don't support compression", Layout::Id));
+    }
+
+    if (std::numeric_limits<std::uint32_t>::max() < size) {
+        throw std::runtime_error(std::format("File \"{}\" is too large for a PACK archive", fileName));
+    }
+}
+
+
+template<class Layout>
+void BasicWriter<Layout>::add(const std::string & fileName, std::string_view content, Codec codec)
+{
+    checkEntry(fileName, content.size(), codec);
+
+    const auto fileSize = static_cast<std::uint32_t>(content.size());
+
+    if (Codec::None == codec) {
+        addStored(fileName, content, fileSize, codec);
+        return;
+    }
+
+    // content already in the archive is found before compressing it, as compression is by far the most expensive part
+    // of adding a file
+    std::uint64_t contentHash = 0;
+
+    if (m_deduplicate) {
+        contentHash = xxh64(content);
+
+        if (const auto * blob = findCompressedBlob(content, contentHash, codec); blob) {
+            m_fileIndex.push_back({fileName, blob->fileOffset, fileSize, blob->storedSize, codec});
+            ++m_filesDeduplicated;
+            m_bytesDeduplicated += blob->storedSize;
+            return;
+        }
+    }
+
+    addStored(fileName, compress(codec, content), fileSize, codec);
+
+    if (m_deduplicate) {
+        const auto & added = m_fileIndex.back();
+        m_compressedBlobsByContent.emplace(contentHash, CompressedBlob{added.fileOffset, fileSize, added.storedSize, codec});
+    }
+}
+
+
+template<class Layout>
+void BasicWriter<Layout>::addStored(const std::string & fileName, std::string_view stored, std::uint32_t fileSize, Codec codec)
+{
+    assert(!m_finished);
+    checkEntry(fileName, stored.size(), codec);
+    const auto storedSize = static_cast<std::uint32_t>(stored.size());
+
+    std::optional<std::uint64_t> hash;
+
+    if (m_deduplicate) {
+        if (const auto * blob = findBlob(stored, codec, fileSize, hash); blob) {
+            m_fileIndex.push_back({fileName, blob->fileOffset, fileSize, storedSize, codec});
+            ++m_filesDeduplicated;
+            m_bytesDeduplicated += storedSize;
+            return;
+        }
+    }
+
+    if (std::numeric_limits<std::uint32_t>::max() < m_dataEnd + storedSize + Layout::EntrySize * (m_fileIndex.size() + 1)) {
+        throw std::runtime_error(std::format("Adding file \"{}\" would make the PACK archive too large", fileName));
+    }
+
+    m_outStream->seekp(static_cast<std::streamoff>(m_dataEnd));
+    m_outStream->write(stored.data(), storedSize);
+
+    if (m_outStream->fail()) {
+        throw std::runtime_error(std::format("Error writing file \"{}\" to PACK archive", fileName));
+    }
+
+    const auto offset = static_cast<std::uint32_t>(m_dataEnd);
+    m_dataEnd += storedSize;
+    m_fileIndex.push_back({fileName, offset, fileSize, storedSize, codec});
+
+    if (m_deduplicate) {
+        m_blobsBySize[storedSize].push_back({offset, fileSize, codec, hash});
+    }
+}
+
+
+template<class Layout>
+void BasicWriter<Layout>::addFile(const std::string & fileName, const std::string & path, Codec codec)
+{
+    auto in = std::ifstream(path, std::ios::binary);
+
+    if (!in) {
+        throw std::runtime_error(std::format("Error opening file \"{}\"", path));
+    }
+
+    std::ostringstream content;
+    content << in.rdbuf();
+
+    if (in.bad()) {
+        throw std::runtime_error(std::format("Error reading file \"{}\"", path));
+    }
+
+    add(fileName, content.view(), codec);
+}
+
+
+template<class Layout>
+void BasicWriter<Layout>::finish()
+{
+    assert(!m_finished);
+    m_finished = true;
+    std::string index(Layout::EntrySize * m_fileIndex.size(), 0);
+    char * entry = index.data();
+
+    for (const auto & indexEntry : m_fileIndex) {
+        indexEntry.fileName.copy(entry, Layout::NameLength);
+        writeUint32(entry + Layout::NameLength, indexEntry.fileOffset);
+        writeUint32(entry + Layout::NameLength + 4, indexEntry.fileSize);
+
+        if constexpr (Layout::Compressed) {
+            writeUint32(entry + Layout::NameLength + 8, indexEntry.storedSize);
+            writeUint32(entry + Layout::NameLength + 12, Layout::compressionField(indexEntry.codec));
+        }
+
+        entry += Layout::EntrySize;
+    }
+
+    std::array<char, HeaderSize> header{};
+    Layout::Id.copy(header.data(), 4);
+    writeUint32(header.data() + 4, static_cast<std::uint32_t>(m_dataEnd));
+    writeUint32(header.data() + 8, static_cast<std::uint32_t>(index.size()));
+
+    m_outStream->seekp(static_cast<std::streamoff>(m_dataEnd));
+    m_outStream->write(index.data(), static_cast<std::streamsize>(index.size()));
+    m_outStream->seekp(0);
+    m_outStream->write(header.data(), HeaderSize);
+    m_outStream->flush();
+
+    if (m_outStream->fail()) {
+        throw std::runtime_error("Error writing PACK archive index");
+    }
+}
+
+
+template class Id::Pack::BasicWriter<PackLayout>;
+template class Id::Pack::BasicWriter<SinLayout>;
+template class Id::Pack::BasicWriter<DaikatanaLayout>;
+template class Id::Pack::BasicWriter<ExtendedLayout>;
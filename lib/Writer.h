@@ -0,0 +1,251 @@
+#ifndef LIBIDPAK_PACKWRITER_H
+#define LIBIDPAK_PACKWRITER_H
+
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Codecs.h"
+#include "Layouts.h"
+
+namespace Id::Pack
+{
+    /**
+     * Writes ID PACK archives (.pak), and the variants of the format described by the layouts in Layouts.h.
+     *
+     * Files are written to the archive as they are added, and the index and header are written by finish().
+     *
+     * By default the writer deduplicates content: a file whose stored content is identical to that of a file already in
+     * the archive is not written again, its index entry points at the existing data instead. Files are bucketed by
+     * stored size first, so content is only hashed (with XXH64) when another file of the same size has been added, and
+     * a matching hash is confirmed by comparing the content before the data is shared.
+     *
+     * The writer is instantiated in the library for the same layouts as BasicReader - use the Writer, SinWriter,
+     * DaikatanaWriter and ExtendedWriter aliases.
+     */
+    template<class Layout>
+    class BasicWriter
+    {
+    public:
+        /**
+         * Initialise a new Writer to write a PACK archive to a file.
+         *
+         * Any existing file is overwritten.
+         *
+         * @param fileName The file to write.
+         * @throws std::runtime_error if the file can't be opened.
+         */
+        explicit BasicWriter(const std::string & fileName);
+
+        /**
+         * @param stream The stream to write to. It must be readable and seekable, so that deduplicated content can be
+         * compared and the header written once the index is complete. The caller is responsible for ensuring the
+         * stream lives as long as the writer using it.
+         */
+        explicit BasicWriter(std::iostream & stream);
+
+        // Writer instances can't be copied or moved
+        BasicWriter(const BasicWriter &) = delete;
+        BasicWriter(BasicWriter &&) = delete;
+        void operator = (const BasicWriter &) = delete;
+        void operator = (BasicWriter &&) = delete;
+
+        /**
+         * Destroy the writer, calling finish() (and ignoring any errors) if it has not already been called. If the writer
+         * is destroyed by an exception the index is not written, and an archive the writer created is removed.
+         */
+        virtual ~BasicWriter() noexcept;
+
+        /** Set whether files with identical content are stored once. This affects only files added afterwards. */
+        void setDeduplicate(bool deduplicate) noexcept
+        {
+            m_deduplicate = deduplicate;
+        }
+
+        /** @return Whether files with identical content are stored once. */
+        bool deduplicate() const noexcept
+        {
+            return m_deduplicate;
+        }
+
+        /**
+         * Add a file to the archive.
+         *
+         * @param fileName The name of the file in the archive.
+         * @param content The content of the file.
+         * @param codec The codec to store the file with. Only None is supported for layouts without compression.
+         * @throws std::runtime_error if the name is too long, the layout doesn't support the codec, the content can't
+         * be compressed or written, or the archive would be too large.
+         */
+        void add(const std::string & fileName, std::string_view content, Codec codec = Codec::None);
+
+        /**
+         * Add a file whose content is already stored with a codec, such as a file copied from another archive, without
+         * compressing it again.
+         *
+         * @param fileName The name of the file in the archive.
+         * @param stored The content of the file as stored with the codec.
+         * @param fileSize The size of the file's content once decompressed.
+         * @param codec The codec the content is stored with. Only None is supported for layouts without compression.
+         * @throws std::runtime_error for any of the reasons add() throws.
+         */
+        void addStored(const std::string & fileName, std::string_view stored, std::uint32_t fileSize, Codec codec = Codec::None);
+
+        /**
+         * Add a file from the local filesystem to the archive.
+         *
+         * @param fileName The name of the file in the archive.
+         * @param path The path of the file to add.
+         * @param codec The codec to store the file with. Only None is supported for layouts without compression.
+         * @throws std::runtime_error if the file can't be read, or for any of the reasons add() throws.
+         */
+        void addFile(const std::string & fileName, const std::string & path, Codec codec = Codec::None);
+
+        /**
+         * Write the index and header, completing the archive.
+         *
+         * No more files can be added once the archive is finished.
+         *
+         * @throws std::runtime_error if the index or header can't be written.
+         */
+        void finish();
+
+        /** @return The number of files added to the archive. */
+        int fileCount() const noexcept
+        {
+            return static_cast<int>(m_fileIndex.size());
+        }
+
+        /** @return The number of files whose content was shared with a file already in the archive. */
+        int filesDeduplicated() const noexcept
+        {
+            return m_filesDeduplicated;
+        }
+
+        /** @return The number of bytes of stored content that deduplication avoided writing. */
+        std::uint64_t bytesDeduplicated() const noexcept
+        {
+            return m_bytesDeduplicated;
+        }
+
+    private:
+        /** An entry for the archive's index. */
+        struct IndexEntry
+        {
+            std::string fileName;
+            std::uint32_t fileOffset;
+            std::uint32_t fileSize;
+            std::uint32_t storedSize;
+            Codec codec;
+        };
+
+        /** A run of stored content in the archive, which files with identical content can share. */
+        struct Blob
+        {
+            std::uint32_t fileOffset;
+            std::uint32_t fileSize;
+            Codec codec;
+
+            /** The XXH64 hash of the stored content, once it's been needed to compare with another blob of the same size. */
+            std::optional<std::uint64_t> hash;
+        };
+
+        /** Compressed content in the archive, which files with the same content and codec can share without compressing it. */
+        struct CompressedBlob
+        {
+            std::uint32_t fileOffset;
+            std::uint32_t fileSize;
+            std::uint32_t storedSize;
+            Codec codec;
+        };
+
+        /**
+         * Internal constructor to which all other constructors delegate.
+         *
+         * @param out The stream to which the archive is being written.
+         * @param owned Whether or not the stream pointer is owned by the Writer instance.
+         */
+        BasicWriter(std::iostream * out, bool owned);
+
+        /**
+         * Check a file can be added to the archive.
+         *
+         * @throws std::runtime_error if the name is too long, the layout doesn't support the codec, or the content is too
+         * large.
+         */
+        void checkEntry(const std::string & fileName, std::size_t size, Codec codec) const;
+
+        /** Read some stored content back from the archive. */
+        std::string readStored(std::uint32_t offset, std::uint32_t size);
+
+        /**
+         * Find a blob with identical stored content, hashing and comparing content as required.
+         *
+         * @param hash Set to the XXH64 hash of the stored content, if it had to be computed.
+         */
+        const Blob * findBlob(std::string_view stored, Codec codec, std::uint32_t fileSize, std::optional<std::uint64_t> & hash);
+
+        /**
+         * Find compressed content that decompresses to a file's content with a codec.
+         *
+         * @param contentHash The XXH64 hash of the content.
+         */
+        const CompressedBlob * findCompressedBlob(std::string_view content, std::uint64_t contentHash, Codec codec);
+
+        /** The stream to which the archive is being written. */
+        std::iostream * m_outStream;
+
+        /** Whether the Writer object owns the stream pointer, and will delete it on destruction. */
+        bool m_ownedStream;
+
+        /** The name of the file the writer created, or empty if it was given a stream. */
+        std::string m_fileName;
+
+        /** The number of exceptions in flight when the writer was constructed. */
+        int m_uncaughtExceptions;
+
+        /** Whether finish() has been called. */
+        bool m_finished = false;
+
+        /** Whether content is deduplicated. */
+        bool m_deduplicate = true;
+
+        /** The offset at which the next stored content will be written, which is where the index will be written. */
+        std::uint64_t m_dataEnd;
+
+        /** The index of the archive, in the order the files were added. */
+        std::vector<IndexEntry> m_fileIndex;
+
+        /** The stored content in the archive, bucketed by stored size. */
+        std::unordered_map<std::uint32_t, std::vector<Blob>> m_blobsBySize;
+
+        /** The content compressed by add(), keyed by the XXH64 hash of the content before compression. */
+        std::unordered_multimap<std::uint64_t, CompressedBlob> m_compressedBlobsByContent;
+
+        // Deduplication statistics
+        int m_filesDeduplicated = 0;
+        std::uint64_t m_bytesDeduplicated = 0;
+    };
+
+    extern template class BasicWriter<PackLayout>;
+    extern template class BasicWriter<SinLayout>;
+    extern template class BasicWriter<DaikatanaLayout>;
+    extern template class BasicWriter<ExtendedLayout>;
+
+    /** Writes Quake PACK archives. */
+    using Writer = BasicWriter<PackLayout>;
+
+    /** Writes SiN SPAK archives. */
+    using SinWriter = BasicWriter<SinLayout>;
+
+    /** Writes Daikatana PACK archives. */
+    using DaikatanaWriter = BasicWriter<DaikatanaLayout>;
+
+    /** Writes extended PAKX archives. */
+    using ExtendedWriter = BasicWriter<ExtendedLayout>;
+}
+
+#endif
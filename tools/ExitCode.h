@@ -11,6 +11,9 @@ namespace Id::Pack::Tools
         UnrecognisedAction = 2,
         MissingArgument = 50,
         InvalidArgument = 51,
+        VerificationFailed = 60,
+        ArchivesDiffer = 61,
+        NoMatches = 62,
     };
 }
 
@@ -0,0 +1,532 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <format>
+#include <limits>
+#include <random>
+#include <thread>
+#include "bench.h"
+#include "../../output.h"
+#include "../../ExitCode.h"
+#include "../../../sdk/Reader"
+
+using Id::Pack::Tools::PackFile::ActionArguments;
+using Id::Pack::Tools::ExitCode;
+using Id::Pack::Tools::error;
+using Id::Pack::AccessHint;
+using Id::Pack::withReader;
+
+extern std::string g_executable;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    /** The workloads the bench action can run. */
+    enum class Workload
+    {
+        Lookup,
+        Read,
+        Extract,
+        Concurrent,
+    };
+
+    /**
+     * The options controlling the benchmark.
+     */
+    struct Options
+    {
+        bool verbose = false;
+        bool dropCaches = false;
+        std::vector<Workload> workloads;
+        std::uint64_t operations = 10'000;
+        unsigned int runs = 1;
+        unsigned int threads = 0;
+        std::uint32_t minReadSize = 1;
+        std::uint32_t maxReadSize = 64 * 1024;
+        std::uint64_t seed = 0;
+        std::string pacFileName;
+    };
+
+    /** The outcome of one run of a workload. */
+    struct Result
+    {
+        /** The latency of each operation, in nanoseconds. */
+        std::vector<std::uint64_t> latencies;
+
+        /** The number of bytes of file content read. */
+        std::uint64_t bytes = 0;
+
+        /** The time the run took. */
+        Clock::duration elapsed{};
+    };
+
+    /** The width of the bars in latency histograms. */
+    constexpr std::size_t HistogramWidth = 40;
+
+    /**
+     * Show the usage message for the bench action.
+     */
+    void usage() noexcept
+    {
+        std::cout << g_executable << R"( bench [-v] [-w workload...] [-n operations] [-r runs] [-j threads] [--read-size min[-max]] [--seed seed] [--drop-caches] packfile
+
+  Options
+    -v             show a latency histogram for each run
+    -w             the workload to run: lookup, read, extract or concurrent. Give -w more than once to run several. The
+                   default is to run all of them
+    -n             the number of operations in each run of the lookup, read and concurrent workloads. The default is
+                   10000
+    -r             the number of times to run each workload. The default is 1
+    -j             the number of threads for the concurrent workload. The default is one per hardware thread
+    --read-size    the range of sizes, in bytes, of the reads in the read workload. The default is 1-65536
+    --seed         the seed for the random choices the workloads make, so runs can be repeated exactly. The default is 0
+    --drop-caches  release the PACK file from the page cache before each run, so that every run reads from storage
+
+  Arguments
+    packfile  The path to the PACK file to benchmark
+
+  Workloads
+    lookup      look up randomly chosen files by name with has() and fileIndex()
+    read        read a randomly sized chunk from a random position in a randomly chosen file with File::read()
+    extract     read the content of every file in the order they're stored with File::contents()
+    concurrent  read the content of randomly chosen files with File::contents() from several threads sharing one reader
+
+  Each run opens the PACK file afresh, so loading the index is part of the first operation. The throughput and the
+  median, 99th and 99.9th percentile latency of the operations in each run are reported.
+)";
+    }
+
+    /** @return The workload named on the command line. */
+    Workload parseWorkload(const std::string & name)
+    {
+        if ("lookup" == name) {
+            return Workload::Lookup;
+        }
+
+        if ("read" == name) {
+            return Workload::Read;
+        }
+
+        if ("extract" == name) {
+            return Workload::Extract;
+        }
+
+        if ("concurrent" == name) {
+            return Workload::Concurrent;
+        }
+
+        throw std::runtime_error(std::format("Unknown workload \"{}\"", name));
+    }
+
+    /** @return The name of a workload. */
+    std::string_view workloadName(Workload workload)
+    {
+        switch (workload) {
+            case Workload::Lookup:
+                return "lookup";
+
+            case Workload::Read:
+                return "read";
+
+            case Workload::Extract:
+                return "extract";
+
+            case Workload::Concurrent:
+                return "concurrent";
+        }
+
+        return {};
+    }
+
+    /**
+     * Parse an unsigned integer option argument.
+     *
+     * @throws std::runtime_error if the argument isn't a valid, positive number.
+     */
+    std::uint64_t parseCount(const std::string & option, const std::string & value)
+    {
+        std::size_t pos = 0;
+        std::uint64_t count = 0;
+
+        try {
+            count = std::stoull(value, &pos);
+        } catch (const std::logic_error &) {
+        }
+
+        if (0 == count || pos != value.size() || value.starts_with('-')) {
+            throw std::runtime_error(std::format("Invalid argument \"{}\" for {}", value, option));
+        }
+
+        return count;
+    }
+
+    /**
+     * Parse the command-line arguments into a set of Options.
+     *
+     * @param args
+     * @return The parsed options.
+     * @throws std::runtime_error if the args are not valid.
+     */
+    Options parseArguments(const ActionArguments & args)
+    {
+        Options opts;
+
+        for (auto it = args.cbegin(); it != args.cend(); ++it) {
+            const auto & arg = *it;
+
+            if ("-v" == arg || "--verbose" == arg) {
+                opts.verbose = true;
+            } else if ("--drop-caches" == arg) {
+                opts.dropCaches = true;
+            } else if ("-w" == arg || "-n" == arg || "-r" == arg || "-j" == arg || "--read-size" == arg || "--seed" == arg) {
+                if (args.cend() == it + 1) {
+                    throw std::runtime_error(std::format("Expected argument for {}", arg));
+                }
+
+                ++it;
+
+                if ("-w" == arg) {
+                    opts.workloads.push_back(parseWorkload(*it));
+                } else if ("-n" == arg) {
+                    opts.operations = parseCount(arg, *it);
+                } else if ("-r" == arg) {
+                    opts.runs = static_cast<unsigned int>(std::min<std::uint64_t>(parseCount(arg, *it), 1'000'000));
+                } else if ("-j" == arg) {
+                    opts.threads = static_cast<unsigned int>(std::min<std::uint64_t>(parseCount(arg, *it), 1024));
+                } else if ("--seed" == arg) {
+                    opts.seed = ("0" == *it ? 0 : parseCount(arg, *it));
+                } else {
+                    const auto separator = it->find('-');
+                    const auto min = parseCount(arg, it->substr(0, separator));
+                    const auto max = (std::string::npos == separator ? min : parseCount(arg, it->substr(separator + 1)));
+
+                    if (min > max || std::numeric_limits<int>::max() < max) {
+                        throw std::runtime_error(std::format("Invalid argument \"{}\" for {}", *it, arg));
+                    }
+
+                    opts.minReadSize = static_cast<std::uint32_t>(min);
+                    opts.maxReadSize = static_cast<std::uint32_t>(max);
+                }
+            } else if (opts.pacFileName.empty()) {
+                opts.pacFileName = arg;
+            } else {
+                throw std::runtime_error(std::format("Unexpected argument \"{}\"", arg));
+            }
+        }
+
+        if (opts.pacFileName.empty()) {
+            throw std::runtime_error("You must provide the pac file to benchmark.");
+        }
+
+        if (opts.workloads.empty()) {
+            opts.workloads = {Workload::Lookup, Workload::Read, Workload::Extract, Workload::Concurrent};
+        }
+
+        if (0 == opts.threads) {
+            opts.threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        return opts;
+    }
+
+    /** Time an operation, recording its latency. */
+    template<class Operation>
+    void timed(std::vector<std::uint64_t> & latencies, Operation operation)
+    {
+        const auto start = Clock::now();
+        operation();
+        latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    }
+
+    /** Load a reader's index, as the first operation of a run. */
+    template<class Reader>
+    void loadIndex(const Reader & reader, Result & result)
+    {
+        timed(result.latencies, [&reader]() { reader.fileCount(); });
+        result.elapsed += std::chrono::nanoseconds(result.latencies.back());
+    }
+
+    /** Look up randomly chosen files by name. */
+    template<class Reader>
+    void lookupFiles(const Reader & reader, const Options & opts, Result & result)
+    {
+        std::mt19937_64 random(opts.seed);
+        std::vector<std::string> names;
+        int found = 0;
+
+        // the names are fetched up front so that only the lookups are timed
+        loadIndex(reader, result);
+
+        for (int idx = 0; idx < reader.fileCount(); ++idx) {
+            names.push_back(reader.fileName(idx));
+        }
+
+        if (names.empty()) {
+            return;
+        }
+
+        std::uniform_int_distribution<std::size_t> file(0, names.size() - 1);
+        const auto start = Clock::now();
+
+        for (std::uint64_t operation = 1; operation < opts.operations; ++operation) {
+            const auto & name = names[file(random)];
+
+            timed(result.latencies, [&]() {
+                found += (reader.has(name) ? reader.fileIndex(name) : 0);
+            });
+        }
+
+        result.elapsed += Clock::now() - start;
+
+        if (0 > found) {
+            error("Lookups failed");
+        }
+    }
+
+    /** Read randomly sized chunks from random positions in randomly chosen files. */
+    template<class Reader>
+    void readChunks(const Reader & reader, const Options & opts, Result & result)
+    {
+        std::mt19937_64 random(opts.seed);
+        std::uniform_int_distribution<std::uint32_t> readSize(opts.minReadSize, opts.maxReadSize);
+        std::vector<int> files;
+
+        loadIndex(reader, result);
+
+        for (int idx = 0; idx < reader.fileCount(); ++idx) {
+            if (0 < reader.fileSize(idx)) {
+                files.push_back(idx);
+            }
+        }
+
+        if (files.empty()) {
+            return;
+        }
+
+        std::uniform_int_distribution<std::size_t> file(0, files.size() - 1);
+        const auto start = Clock::now();
+
+        for (std::uint64_t operation = 1; operation < opts.operations; ++operation) {
+            const auto idx = files[file(random)];
+            const auto size = std::min<int>(static_cast<int>(readSize(random)), reader.fileSize(idx));
+            const auto pos = std::uniform_int_distribution<int>(0, reader.fileSize(idx) - size)(random);
+
+            timed(result.latencies, [&]() {
+                auto content = reader.file(idx);
+
+                if (0 < pos) {
+                    content.seek(pos);
+                }
+
+                result.bytes += content.read(size).size();
+            });
+        }
+
+        result.elapsed += Clock::now() - start;
+    }
+
+    /** Read the content of every file in the order they're stored. */
+    template<class Reader>
+    void extractFiles(const Reader & reader, const Options &, Result & result)
+    {
+        std::vector<int> files;
+
+        loadIndex(reader, result);
+
+        for (int idx = 0; idx < reader.fileCount(); ++idx) {
+            files.push_back(idx);
+        }
+
+        std::ranges::stable_sort(files, {}, [&reader](int idx) { return static_cast<std::uint32_t>(reader.fileOffset(idx)); });
+        const auto start = Clock::now();
+
+        for (const auto idx : files) {
+            timed(result.latencies, [&]() {
+                result.bytes += reader.file(idx).contents().size();
+            });
+        }
+
+        result.elapsed += Clock::now() - start;
+    }
+
+    /** Read the content of randomly chosen files from several threads sharing the reader. */
+    template<class Reader>
+    void readConcurrently(const Reader & reader, const Options & opts, Result & result)
+    {
+        loadIndex(reader, result);
+
+        if (0 == reader.fileCount()) {
+            return;
+        }
+
+        std::vector<Result> threadResults(opts.threads);
+        const auto start = Clock::now();
+
+        {
+            std::vector<std::jthread> threads;
+
+            for (unsigned int thread = 0; thread < opts.threads; ++thread) {
+                threads.emplace_back([&reader, &opts, &threadResults, thread]() {
+                    auto & threadResult = threadResults[thread];
+                    std::mt19937_64 random(opts.seed + thread);
+                    std::uniform_int_distribution<int> file(0, reader.fileCount() - 1);
+                    const auto operations = opts.operations / opts.threads + (thread < opts.operations % opts.threads ? 1 : 0);
+                    threadResult.latencies.reserve(operations);
+
+                    for (std::uint64_t operation = 0; operation < operations; ++operation) {
+                        const auto idx = file(random);
+
+                        timed(threadResult.latencies, [&]() {
+                            threadResult.bytes += reader.file(idx).contents().size();
+                        });
+                    }
+                });
+            }
+        }
+
+        result.elapsed += Clock::now() - start;
+
+        for (const auto & threadResult : threadResults) {
+            result.latencies.insert(result.latencies.end(), threadResult.latencies.begin(), threadResult.latencies.end());
+            result.bytes += threadResult.bytes;
+        }
+    }
+
+    /** Format a duration in nanoseconds with a unit suited to its magnitude. */
+    std::string formatNanoseconds(double nanoseconds)
+    {
+        if (1'000 > nanoseconds) {
+            return std::format("{:.0f} ns", nanoseconds);
+        }
+
+        if (1'000'000 > nanoseconds) {
+            return std::format("{:.2f} us", nanoseconds / 1'000);
+        }
+
+        if (1'000'000'000 > nanoseconds) {
+            return std::format("{:.2f} ms", nanoseconds / 1'000'000);
+        }
+
+        return std::format("{:.2f} s", nanoseconds / 1'000'000'000);
+    }
+
+    /** @return The latency at a percentile of the sorted latencies. */
+    std::uint64_t percentile(const std::vector<std::uint64_t> & sorted, double percent)
+    {
+        const auto rank = static_cast<std::size_t>(percent / 100 * static_cast<double>(sorted.size()));
+        return sorted[std::min(rank, sorted.size() - 1)];
+    }
+
+    /** Report the throughput and latencies of a run. */
+    void report(Workload workload, unsigned int run, Result & result, const Options & opts)
+    {
+        auto & latencies = result.latencies;
+        const auto seconds = std::chrono::duration<double>(result.elapsed).count();
+        std::cout << std::format("{} (run {} of {}): {} operations in {:.3f} s, {:.0f} operations/s", workloadName(workload), run, opts.runs, latencies.size(), seconds, static_cast<double>(latencies.size()) / seconds);
+
+        if (0 < result.bytes) {
+            std::cout << std::format(", {:.1f} MiB/s", static_cast<double>(result.bytes) / (1024 * 1024) / seconds);
+        }
+
+        std::cout << "\n";
+
+        if (latencies.empty()) {
+            return;
+        }
+
+        std::ranges::sort(latencies);
+        std::cout << std::format(
+            "  latency  min {}  p50 {}  p99 {}  p99.9 {}  max {}\n",
+            formatNanoseconds(latencies.front()),
+            formatNanoseconds(percentile(latencies, 50)),
+            formatNanoseconds(percentile(latencies, 99)),
+            formatNanoseconds(percentile(latencies, 99.9)),
+            formatNanoseconds(latencies.back())
+        );
+
+        if (!opts.verbose) {
+            return;
+        }
+
+        // the histogram has a bucket for each power of two nanoseconds, from the fastest operation to the slowest
+        const auto firstBucket = std::bit_width(latencies.front());
+        const auto lastBucket = std::bit_width(latencies.back());
+        std::vector<std::size_t> counts(lastBucket - firstBucket + 1);
+
+        for (const auto latency : latencies) {
+            ++counts[std::bit_width(latency) - firstBucket];
+        }
+
+        const auto maxCount = std::ranges::max(counts);
+
+        for (std::size_t bucket = 0; bucket < counts.size(); ++bucket) {
+            const auto lower = (0 == firstBucket + bucket ? 0 : std::uint64_t{1} << (firstBucket + bucket - 1));
+            const auto bar = (counts[bucket] * HistogramWidth + maxCount - 1) / maxCount;
+            std::cout << std::format("  {:>10} - {:<10} {:>10}", formatNanoseconds(lower), formatNanoseconds(std::uint64_t{1} << (firstBucket + bucket)), counts[bucket]);
+            std::cout << (0 < bar ? " " + std::string(bar, '#') : "") << "\n";
+        }
+    }
+}
+
+
+/**
+ * Run benchmark workloads against an ID PACK archive, reporting throughput and latency.
+ *
+ * @param args The command-line arguments provided to the bench action.
+ *
+ * @return ExitCode::Ok on success, another ExitCode if the command is not valid, a negative int if something went wrong
+ * trying to benchmark the archive.
+ */
+int Id::Pack::Tools::PackFile::Actions::bench(const ActionArguments & args) noexcept
+{
+    Options opts;
+
+    try {
+        opts = parseArguments(args);
+    } catch (const std::runtime_error & err) {
+        error(err.what());
+        usage();
+        return ExitCode::InvalidArgument;
+    }
+
+    try {
+        for (const auto workload : opts.workloads) {
+            for (unsigned int run = 1; run <= opts.runs; ++run) {
+                Result result;
+                result.latencies.reserve(Workload::Extract == workload ? 0 : opts.operations);
+
+                withReader(opts.pacFileName, [&opts, &result, workload](const auto & reader) {
+                    if (opts.dropCaches) {
+                        reader.advise(AccessHint::DontNeed);
+                    }
+
+                    switch (workload) {
+                        case Workload::Lookup:
+                            lookupFiles(reader, opts, result);
+                            break;
+
+                        case Workload::Read:
+                            readChunks(reader, opts, result);
+                            break;
+
+                        case Workload::Extract:
+                            extractFiles(reader, opts, result);
+                            break;
+
+                        case Workload::Concurrent:
+                            readConcurrently(reader, opts, result);
+                            break;
+                    }
+                });
+
+                report(workload, run, result, opts);
+            }
+        }
+    } catch (const std::exception & err) {
+        error(std::format(R"(Failed benchmarking PACK file "{}": {})", opts.pacFileName, err.what()));
+        return -1;
+    }
+
+    return ExitCode::Ok;
+}
@@ -0,0 +1,11 @@
+#ifndef TOOLS_PACKFILE_ACTION_BENCH_H
+#define TOOLS_PACKFILE_ACTION_BENCH_H
+
+#include "../actions.h"
+
+namespace Id::Pack::Tools::PackFile::Actions
+{
+    int bench(const ActionArguments &args) noexcept;
+}
+
+#endif
@@ -0,0 +1,230 @@
+#include <filesystem>
+#include <format>
+#include "create.h"
+#include "../../output.h"
+#include "../../ExitCode.h"
+#include "../../../sdk/Writer"
+
+using Id::Pack::Tools::PackFile::ActionArguments;
+using Id::Pack::Tools::ExitCode;
+using Id::Pack::Tools::error;
+using Id::Pack::Tools::info;
+using Id::Pack::Codec;
+
+extern std::string g_executable;
+
+namespace
+{
+    /**
+     * The options controlling the creation.
+     */
+    struct Options
+    {
+        bool verbose = false;
+        bool deduplicate = true;
+        std::string format = "pack";
+        Codec codec = Codec::None;
+        std::string pacFileName;
+        std::list<std::string> paths;
+    };
+
+    /**
+     * Show the usage message for the create action.
+     */
+    void usage() noexcept
+    {
+        std::cout << g_executable << R"( create [-v] [--format format] [--codec codec] [--no-dedupe] packfile path [...path]
+
+  Options
+    -v           print verbose output
+    --format     the format of the archive to create: pack (the default), sin or pakx
+    --codec      the codec to compress files with: none (the default), daikatana, zlib or zstd. Compression requires the
+                 pakx format, which is the default when a codec is given
+    --no-dedupe  store files with identical content separately
+
+  Arguments
+    packfile     The path to the PACK file to create. Any existing file is overwritten
+    path         One or more files or directories to add to the PACK file. Files are named in the archive as given on
+                 the command line; the files under a directory are named relative to that directory
+)";
+    }
+
+    /**
+     * Parse a codec name.
+     *
+     * @throws std::runtime_error if the name is not a recognised codec.
+     */
+    Codec parseCodec(const std::string & name)
+    {
+        for (const auto codec : {Codec::None, Codec::Daikatana, Codec::Zlib, Codec::Zstd}) {
+            if (name == Id::Pack::codecName(codec)) {
+                if (!Id::Pack::isAvailable(codec)) {
+                    throw std::runtime_error(std::format("The {} codec is not available in this build", name));
+                }
+
+                return codec;
+            }
+        }
+
+        throw std::runtime_error(std::format("Unrecognised codec \"{}\"", name));
+    }
+
+    /**
+     * Parse the command-line arguments into a set of Options.
+     *
+     * @param args
+     * @return The parsed options.
+     * @throws std::runtime_error if the args are not valid.
+     */
+    Options parseArguments(const ActionArguments & args)
+    {
+        Options opts;
+        bool explicitFormat = false;
+
+        for (auto it = args.cbegin(); it != args.cend(); ++it) {
+            const auto & arg = *it;
+
+            if ("-v" == arg || "--verbose" == arg) {
+                opts.verbose = true;
+            } else if ("--no-dedupe" == arg) {
+                opts.deduplicate = false;
+            } else if ("--format" == arg || "--codec" == arg) {
+                if (args.cend() == it + 1) {
+                    throw std::runtime_error(std::format("Expected argument for {}", arg));
+                }
+
+                ++it;
+
+                if ("--codec" == arg) {
+                    opts.codec = parseCodec(*it);
+                } else if ("pack" == *it || "sin" == *it || "pakx" == *it) {
+                    opts.format = *it;
+                    explicitFormat = true;
+                } else {
+                    throw std::runtime_error(std::format("Unrecognised format \"{}\"", *it));
+                }
+            } else if (opts.pacFileName.empty()) {
+                opts.pacFileName = arg;
+            } else {
+                opts.paths.push_back(arg);
+            }
+        }
+
+        if (Codec::None != opts.codec) {
+            if (!explicitFormat) {
+                opts.format = "pakx";
+            } else if ("pakx" != opts.format) {
+                throw std::runtime_error("Compression requires the pakx format.");
+            }
+        }
+
+        if (opts.paths.empty()) {
+            throw std::runtime_error("You must provide the pac file to create and at least one file or directory to add to it.");
+        }
+
+        return opts;
+    }
+
+    /**
+     * Add the files named in the options to an archive.
+     *
+     * @return The number of bytes of content added.
+     */
+    template<class Writer>
+    std::uint64_t addFiles(Writer & writer, const Options & opts)
+    {
+        namespace fs = std::filesystem;
+        std::uint64_t totalBytes = 0;
+
+        const auto add = [&](const fs::path & path, const std::string & name) {
+            if (opts.verbose) {
+                std::cout << "Adding \"" << path.string() << "\" as \"" << name << "\"\n";
+            }
+
+            writer.addFile(name, path.string(), opts.codec);
+            totalBytes += fs::file_size(path);
+        };
+
+        for (const auto & path : opts.paths) {
+            if (!fs::is_directory(path)) {
+                add(path, fs::path(path).lexically_normal().relative_path().generic_string());
+                continue;
+            }
+
+            // sorted so that archives are reproducible
+            std::vector<fs::path> files;
+
+            for (const auto & entry : fs::recursive_directory_iterator(path)) {
+                // the archive being written may be inside a directory being packed
+                std::error_code err;
+
+                if (entry.is_regular_file() && !fs::equivalent(entry.path(), opts.pacFileName, err)) {
+                    files.push_back(entry.path());
+                }
+            }
+
+            std::ranges::sort(files);
+
+            for (const auto & file : files) {
+                add(file, file.lexically_relative(path).generic_string());
+            }
+        }
+
+        writer.finish();
+        return totalBytes;
+    }
+
+    /**
+     * Create the archive described by a set of options, with the writer for a layout.
+     */
+    template<class Writer>
+    void create(const Options & opts)
+    {
+        Writer writer(opts.pacFileName);
+        writer.setDeduplicate(opts.deduplicate);
+        const auto totalBytes = addFiles(writer, opts);
+
+        info(std::format(R"(Created "{}" with {} file{} ({} bytes))", opts.pacFileName, writer.fileCount(), (1 == writer.fileCount() ? "" : "s"), totalBytes));
+
+        if (opts.deduplicate) {
+            info(std::format("Deduplicated {} file{}, saving {} bytes", writer.filesDeduplicated(), (1 == writer.filesDeduplicated() ? "" : "s"), writer.bytesDeduplicated()));
+        }
+    }
+}
+
+
+/**
+ * Create an ID PACK archive from files in the local filesystem.
+ *
+ * @param args The command-line arguments provided to the create action.
+ *
+ * @return ExitCode::Ok on success, another ExitCode if the command is not valid, a negative int if something went wrong
+ * trying to create the archive.
+ */
+int Id::Pack::Tools::PackFile::Actions::create(const ActionArguments & args) noexcept
+{
+    Options opts;
+
+    try {
+        opts = parseArguments(args);
+    } catch (const std::runtime_error & err) {
+        error(err.what());
+        usage();
+        return ExitCode::InvalidArgument;
+    }
+
+    try {
+        if ("sin" == opts.format) {
+            ::create<Id::Pack::SinWriter>(opts);
+        } else if ("pakx" == opts.format) {
+            ::create<Id::Pack::ExtendedWriter>(opts);
+        } else {
+            ::create<Id::Pack::Writer>(opts);
+        }
+    } catch (const std::exception & err) {
+        error(std::format(R"(Failed creating PACK file "{}": {})", opts.pacFileName, err.what()));
+        return -1;
+    }
+
+    return ExitCode::Ok;
+}
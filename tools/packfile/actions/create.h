@@ -0,0 +1,11 @@
+#ifndef TOOLS_PACKFILE_ACTION_CREATE_H
+#define TOOLS_PACKFILE_ACTION_CREATE_H
+
+#include "../actions.h"
+
+namespace Id::Pack::Tools::PackFile::Actions
+{
+    int create(const ActionArguments &args) noexcept;
+}
+
+#endif
@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <map>
+#include <mutex>
+#include <thread>
+#include "diff.h"
+#include "../../output.h"
+#include "../../ExitCode.h"
+#include "../../../sdk/Hash"
+#include "../../../sdk/Reader"
+
+using Id::Pack::Tools::PackFile::ActionArguments;
+using Id::Pack::Tools::ExitCode;
+using Id::Pack::Tools::error;
+using Id::Pack::withReader;
+
+extern std::string g_executable;
+
+namespace
+{
+    /**
+     * The options controlling the comparison.
+     */
+    struct Options
+    {
+        bool verbose = false;
+        unsigned int threads = 0;
+        std::string oldPacFileName;
+        std::string newPacFileName;
+    };
+
+    /** The number of bytes of a file each thread reads at a time when hashing content. */
+    constexpr std::size_t ChunkSize = 1024 * 1024;
+
+    /**
+     * Show the usage message for the diff action.
+     */
+    void usage() noexcept
+    {
+        std::cout << g_executable << R"( diff [-v] [-j threads] old-packfile new-packfile
+
+  Options
+    -v            print verbose output - includes the old and new sizes of each file
+    -j            the number of threads to hash content with. The default is one per hardware thread
+
+  Arguments
+    old-packfile  The path to the original PACK file
+    new-packfile  The path to the PACK file to compare with it
+
+  Each added, deleted or modified file is listed, preceded by A, D or M. Files are compared by name and size first, and
+  only files of the same size in both archives have their content compared. The exit code is non-zero if the archives
+  differ.
+)";
+    }
+
+    /**
+     * Parse the command-line arguments into a set of Options.
+     *
+     * @param args
+     * @return The parsed options.
+     * @throws std::runtime_error if the args are not valid.
+     */
+    Options parseArguments(const ActionArguments & args)
+    {
+        Options opts;
+
+        for (auto it = args.cbegin(); it != args.cend(); ++it) {
+            const auto & arg = *it;
+
+            if ("-v" == arg || "--verbose" == arg) {
+                opts.verbose = true;
+            } else if ("-j" == arg) {
+                if (args.cend() == it + 1) {
+                    throw std::runtime_error(std::format("Expected argument for {}", arg));
+                }
+
+                ++it;
+
+                try {
+                    opts.threads = static_cast<unsigned int>(std::stoul(*it));
+                } catch (const std::logic_error &) {
+                    throw std::runtime_error(std::format("Invalid thread count \"{}\"", *it));
+                }
+            } else if (opts.oldPacFileName.empty()) {
+                opts.oldPacFileName = arg;
+            } else if (opts.newPacFileName.empty()) {
+                opts.newPacFileName = arg;
+            } else {
+                throw std::runtime_error(std::format("Unexpected argument \"{}\"", arg));
+            }
+        }
+
+        if (opts.newPacFileName.empty()) {
+            throw std::runtime_error("You must provide the two pac files to compare.");
+        }
+
+        return opts;
+    }
+
+    /**
+     * Map the names of the files in an archive to their indices.
+     *
+     * As with lookups by name, if more than one file has the same name the last one is used.
+     */
+    template<class Reader>
+    std::map<std::string, int> filesByName(const Reader & reader)
+    {
+        std::map<std::string, int> files;
+
+        for (int idx = 0; idx < reader.fileCount(); ++idx) {
+            files.insert_or_assign(reader.fileName(idx), idx);
+        }
+
+        return files;
+    }
+
+    /**
+     * Hash the content of a file in an archive.
+     *
+     * Uncompressed files are hashed directly from the archive a chunk at a time; compressed files are decompressed
+     * first, so that files with the same content compare equal whatever codec they're stored with.
+     *
+     * @param buffer The buffer into which to read each chunk.
+     * @throws std::runtime_error if the content can't be read.
+     */
+    template<class Reader>
+    std::uint64_t contentHash(const Reader & reader, int idx, std::string & buffer)
+    {
+        if (Id::Pack::Codec::None != reader.fileCodec(idx)) {
+            auto file = reader.file(idx);
+            return Id::Pack::xxh64(file.read(file.size()));
+        }
+
+        Id::Pack::Xxh64 hash;
+        std::uint64_t offset = static_cast<std::uint32_t>(reader.fileOffset(idx));
+        std::uint64_t size = static_cast<std::uint32_t>(reader.fileSize(idx));
+
+        while (0 < size) {
+            const auto bytes = std::min<std::uint64_t>(size, buffer.size());
+            reader.source()->read(offset, buffer.data(), bytes);
+            hash.update(std::string_view(buffer.data(), bytes));
+            offset += bytes;
+            size -= bytes;
+        }
+
+        return hash.digest();
+    }
+
+    /** A file with the same name and size in both archives. */
+    struct Candidate
+    {
+        const std::string * name;
+        int oldIdx;
+        int newIdx;
+    };
+
+    /** A file whose content must be hashed, in one archive or the other. */
+    struct HashJob
+    {
+        bool inNew;
+        int idx;
+        std::uint32_t offset;
+        std::size_t candidate;
+    };
+
+    /**
+     * Compare two archives, with the readers for their layouts.
+     *
+     * @return Whether the archives differ.
+     */
+    template<class OldReader, class NewReader>
+    bool diff(const OldReader & oldReader, const NewReader & newReader, const Options & opts)
+    {
+        const auto oldFiles = filesByName(oldReader);
+        const auto newFiles = filesByName(newReader);
+
+        // the status and name of each difference, in name order
+        std::vector<std::pair<char, const std::string *>> changes;
+
+        // the files with the same name and size in both archives, whose content must be compared
+        std::vector<Candidate> candidates;
+
+        auto oldFile = oldFiles.cbegin();
+        auto newFile = newFiles.cbegin();
+
+        while (oldFiles.cend() != oldFile || newFiles.cend() != newFile) {
+            if (newFiles.cend() == newFile || (oldFiles.cend() != oldFile && oldFile->first < newFile->first)) {
+                changes.emplace_back('D', &oldFile->first);
+                ++oldFile;
+            } else if (oldFiles.cend() == oldFile || newFile->first < oldFile->first) {
+                changes.emplace_back('A', &newFile->first);
+                ++newFile;
+            } else {
+                if (oldReader.fileSize(oldFile->second) != newReader.fileSize(newFile->second)) {
+                    changes.emplace_back('M', &oldFile->first);
+                } else {
+                    candidates.push_back({&oldFile->first, oldFile->second, newFile->second});
+                }
+
+                ++oldFile;
+                ++newFile;
+            }
+        }
+
+        // hash the candidates in both archives at once, each in the order its content is stored
+        std::vector<HashJob> oldJobs;
+        std::vector<HashJob> newJobs;
+
+        for (std::size_t candidate = 0; candidate < candidates.size(); ++candidate) {
+            const auto & [name, oldIdx, newIdx] = candidates[candidate];
+            oldJobs.push_back({false, oldIdx, static_cast<std::uint32_t>(oldReader.fileOffset(oldIdx)), candidate});
+            newJobs.push_back({true, newIdx, static_cast<std::uint32_t>(newReader.fileOffset(newIdx)), candidate});
+        }
+
+        std::ranges::sort(oldJobs, {}, &HashJob::offset);
+        std::ranges::sort(newJobs, {}, &HashJob::offset);
+        std::vector<HashJob> jobs;
+        jobs.reserve(oldJobs.size() + newJobs.size());
+
+        for (std::size_t job = 0; job < oldJobs.size(); ++job) {
+            jobs.push_back(oldJobs[job]);
+            jobs.push_back(newJobs[job]);
+        }
+
+        std::vector<std::uint64_t> oldHashes(candidates.size());
+        std::vector<std::uint64_t> newHashes(candidates.size());
+        std::atomic<std::size_t> next = 0;
+        std::mutex mutex;
+        std::exception_ptr failure;
+        auto threads = (0 == opts.threads ? std::max(1u, std::thread::hardware_concurrency()) : opts.threads);
+        threads = std::min<std::size_t>(threads, std::max<std::size_t>(1, jobs.size()));
+
+        const auto work = [&]() {
+            std::string buffer(ChunkSize, 0);
+
+            try {
+                for (auto item = next++; item < jobs.size(); item = next++) {
+                    const auto & job = jobs[item];
+
+                    if (job.inNew) {
+                        newHashes[job.candidate] = contentHash(newReader, job.idx, buffer);
+                    } else {
+                        oldHashes[job.candidate] = contentHash(oldReader, job.idx, buffer);
+                    }
+                }
+            } catch (...) {
+                std::lock_guard lock(mutex);
+
+                if (!failure) {
+                    failure = std::current_exception();
+                }
+
+                // stop the other workers taking any more jobs
+                next = jobs.size();
+            }
+        };
+
+        {
+            std::vector<std::jthread> workers;
+
+            for (unsigned int thread = 0; thread < threads; ++thread) {
+                workers.emplace_back(work);
+            }
+        }
+
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+
+        for (std::size_t candidate = 0; candidate < candidates.size(); ++candidate) {
+            if (oldHashes[candidate] != newHashes[candidate]) {
+                changes.emplace_back('M', candidates[candidate].name);
+            }
+        }
+
+        std::ranges::sort(changes, {}, [](const auto & change) -> const std::string & { return *change.second; });
+
+        for (const auto & [status, name] : changes) {
+            if (!opts.verbose) {
+                std::cout << status << "  " << *name << "\n";
+            } else if ('A' == status) {
+                std::cout << std::format("A  {} ({} bytes)", *name, newReader.fileSize(newFiles.at(*name))) << "\n";
+            } else if ('D' == status) {
+                std::cout << std::format("D  {} ({} bytes)", *name, oldReader.fileSize(oldFiles.at(*name))) << "\n";
+            } else {
+                std::cout << std::format("M  {} ({} -> {} bytes)", *name, oldReader.fileSize(oldFiles.at(*name)), newReader.fileSize(newFiles.at(*name))) << "\n";
+            }
+        }
+
+        return !changes.empty();
+    }
+}
+
+
+/**
+ * Compare the files in two ID PACK archives.
+ *
+ * @param args The command-line arguments provided to the diff action.
+ *
+ * @return ExitCode::Ok if the archives contain the same files, ExitCode::ArchivesDiffer if they don't, another ExitCode
+ * if the command is not valid, a negative int if something went wrong trying to read the archives.
+ */
+int Id::Pack::Tools::PackFile::Actions::diff(const ActionArguments & args) noexcept
+{
+    Options opts;
+
+    try {
+        opts = parseArguments(args);
+    } catch (const std::runtime_error & err) {
+        error(err.what());
+        usage();
+        return ExitCode::InvalidArgument;
+    }
+
+    try {
+        const auto differ = withReader(opts.oldPacFileName, [&opts](const auto & oldReader) {
+            return withReader(opts.newPacFileName, [&opts, &oldReader](const auto & newReader) {
+                return ::diff(oldReader, newReader, opts);
+            });
+        });
+
+        return (differ ? ExitCode::ArchivesDiffer : ExitCode::Ok);
+    } catch (const std::exception & err) {
+        error(std::format(R"(Failed comparing PACK files "{}" and "{}": {})", opts.oldPacFileName, opts.newPacFileName, err.what()));
+        return -1;
+    }
+}
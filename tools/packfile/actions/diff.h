@@ -0,0 +1,11 @@
+#ifndef TOOLS_PACKFILE_ACTION_DIFF_H
+#define TOOLS_PACKFILE_ACTION_DIFF_H
+
+#include "../actions.h"
+
+namespace Id::Pack::Tools::PackFile::Actions
+{
+    int diff(const ActionArguments &args) noexcept;
+}
+
+#endif
@@ -8,7 +8,7 @@
 using Id::Pack::Tools::PackFile::ActionArguments;
 using Id::Pack::Tools::ExitCode;
 using Id::Pack::Tools::error;
-using Id::Pack::Reader;
+using Id::Pack::withReader;
 
 extern std::string g_executable;
 
@@ -20,6 +20,10 @@ namespace
     struct Options
     {
         bool verbose = false;
+        bool all = false;
+        bool dropBehind = false;
+        unsigned int threads = 0;
+        std::string traceFileName;
         std::string pacFileName;
         std::string destination;
         std::list<int> numberedFiles;
@@ -52,10 +56,18 @@ namespace
      */
     void usage() noexcept
     {
-        std::cout << g_executable << R"( extract [-v] packfile {file | -n index} [...{file | -n index}] destination
+        std::cout << g_executable << R"( extract [-v] [--trace tracefile] packfile {file | -n index} [...{file | -n index}] destination
+       )" << g_executable << R"( extract [-v] [-j threads] [--drop-behind] --all packfile destination
 
   Options
-    -v  print verbose output
+    -v       print verbose output
+    --all    extract every file in the PACK file to the destination directory, creating subdirectories as required
+    -j       with --all, the number of threads to decompress and write files with. The default is one per hardware
+             thread
+    --trace  append a trace of the files extracted, in order, to a trace file for use with the reorder action
+    --drop-behind
+             with --all, release the PACK file's content from the page cache as it's read, so that extracting a large
+             PACK file doesn't evict other processes' cached files
 
   Arguments
     packfile     The path to the PACK file from which to extract content
@@ -89,6 +101,27 @@ namespace
 
             if ("-v" == arg || "--verbose" == arg) {
                 opts.verbose = true;
+            } else if ("--all" == arg) {
+                opts.all = true;
+            } else if ("--drop-behind" == arg) {
+                opts.dropBehind = true;
+            } else if ("-j" == arg || "--trace" == arg) {
+                if (args.cend() == it + 1) {
+                    throw std::runtime_error(std::format("Expected argument for {}", arg));
+                }
+
+                ++it;
+
+                if ("--trace" == arg) {
+                    opts.traceFileName = *it;
+                    continue;
+                }
+
+                try {
+                    opts.threads = static_cast<unsigned int>(std::stoul(*it));
+                } catch (const std::logic_error &) {
+                    throw std::runtime_error(std::format("Invalid thread count \"{}\"", *it));
+                }
             } else if ("-n" == arg) {
                 if (opts.pacFileName.empty()) {
                     throw std::runtime_error("PACK file name must be given before any files to extract.");
@@ -118,6 +151,22 @@ namespace
         opts.destination = opts.namedFiles.back();
         opts.namedFiles.pop_back();
 
+        if (opts.all) {
+            if (!opts.namedFiles.empty() || !opts.numberedFiles.empty()) {
+                throw std::runtime_error("Files to extract can't be given with --all.");
+            }
+
+            if (!opts.traceFileName.empty()) {
+                throw std::runtime_error("Extracting with --all can't be traced.");
+            }
+
+            return opts;
+        }
+
+        if (opts.dropBehind) {
+            throw std::runtime_error("--drop-behind can only be used with --all.");
+        }
+
         if (0 == opts.namedFiles.size() + opts.numberedFiles.size()) {
             throw std::runtime_error("No files to extract - did you forget to specify the destination?");
         }
@@ -168,40 +217,67 @@ int Id::Pack::Tools::PackFile::Actions::extract(const ActionArguments & args) no
         return ExitCode::InvalidArgument;
     }
 
-    auto totalExtractions = opts.namedFiles.size() + opts.numberedFiles.size();
+    if (opts.all) {
+        try {
+            withReader(opts.pacFileName, [&opts](const auto & reader) {
+                if (opts.verbose) {
+                    std::cout << "Extracting all files from \"" << opts.pacFileName << "\" to \"" << opts.destination << "\"\n";
+                }
 
-    try {
-        auto reader = Reader(opts.pacFileName);
+                reader.extractAll(opts.destination, opts.threads, opts.dropBehind);
 
-        if (opts.verbose) {
-            summarise(opts);
+                if (opts.verbose) {
+                    std::cout << "Extracted " << reader.fileCount() << " file" << (1 == reader.fileCount() ? "" : "s") << "\n";
+                }
+            });
+        } catch (const std::exception & err) {
+            error(std::format(R"(Failed extracting from PACK file "{}": {})", opts.pacFileName, err.what()));
+            return -1;
         }
 
-        // extract the named files
-        for (const auto & name : opts.namedFiles) {
-            std::string outputPath = opts.destination;
+        return ExitCode::Ok;
+    }
 
-            if (1 < totalExtractions) {
-                outputPath = std::format("{}/{}", outputPath, name);
-            }
+    auto totalExtractions = opts.namedFiles.size() + opts.numberedFiles.size();
 
+    try {
+        withReader(opts.pacFileName, [&opts, totalExtractions](auto & reader) {
             if (opts.verbose) {
-                std::cout << "Extracting " << reader.fileSize(name) << " bytes from offset " << reader.fileOffset(name) << " of file \"" << name << "\" to \"" << outputPath << "\"\n";
+                summarise(opts);
             }
 
-            reader.extract(name, outputPath);
-        }
+            if (!opts.traceFileName.empty()) {
+                reader.startTrace(opts.traceFileName);
+            }
 
-        // extract the numbered files
-        for (const auto idx : opts.numberedFiles) {
-            std::string outputPath = std::format("{}/{}", opts.destination, reader.fileName(idx));
+            // extract the named files
+            for (const auto & name : opts.namedFiles) {
+                std::string outputPath = opts.destination;
 
-            if (opts.verbose) {
-                std::cout << "Extracting " << reader.fileSize(idx) << " bytes from offset " << reader.fileOffset(idx) << " of file #" << idx << " (\"" << reader.fileName(idx) << "\") to \"" << outputPath << "\"\n";
+                if (1 < totalExtractions) {
+                    outputPath = std::format("{}/{}", outputPath, name);
+                }
+
+                if (opts.verbose) {
+                    std::cout << "Extracting " << reader.fileSize(name) << " bytes from offset " << reader.fileOffset(name) << " of file \"" << name << "\" to \"" << outputPath << "\"\n";
+                }
+
+                reader.extract(name, outputPath);
             }
 
-            reader.extract(idx, outputPath);
-        }
+            // extract the numbered files
+            for (const auto idx : opts.numberedFiles) {
+                std::string outputPath = std::format("{}/{}", opts.destination, reader.fileName(idx));
+
+                if (opts.verbose) {
+                    std::cout << "Extracting " << reader.fileSize(idx) << " bytes from offset " << reader.fileOffset(idx) << " of file #" << idx << " (\"" << reader.fileName(idx) << "\") to \"" << outputPath << "\"\n";
+                }
+
+                reader.extract(idx, outputPath);
+            }
+
+            reader.stopTrace();
+        });
     } catch (const std::runtime_error & err) {
         error(std::format(R"(Failed extracting from PACK file "{}": {})", opts.pacFileName, err.what()));
         return -1;
@@ -0,0 +1,539 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <format>
+#include <functional>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <regex>
+#include <thread>
+#include "grep.h"
+#include "../../output.h"
+#include "../../ExitCode.h"
+#include "../../../sdk/Reader"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using Id::Pack::Tools::PackFile::ActionArguments;
+using Id::Pack::Tools::ExitCode;
+using Id::Pack::Tools::error;
+using Id::Pack::withReader;
+
+extern std::string g_executable;
+
+namespace
+{
+    /**
+     * The options controlling the search.
+     */
+    struct Options
+    {
+        bool fixedString = false;
+        bool ignoreCase = false;
+        bool filesWithMatches = false;
+        unsigned int threads = 0;
+        std::string pattern;
+        std::vector<std::string> pacFileNames;
+    };
+
+    /** The number of bytes of file content to aim for in each job given to the thread pool. */
+    constexpr std::size_t JobSize = 1024 * 1024;
+
+    /** The number of bytes of a file read and searched at a time. */
+    constexpr int ChunkSize = 64 * 1024;
+
+    /**
+     * The longest line a regular expression is matched against. Longer lines are matched a piece of this length at a
+     * time, which bounds the depth to which std::regex recurses. The pieces overlap, so that matches no longer than the
+     * overlap are found even where they span two pieces.
+     */
+    constexpr std::size_t MaxLineLength = 4096;
+    constexpr std::size_t LineOverlap = 256;
+
+    /**
+     * Show the usage message for the grep action.
+     */
+    void usage() noexcept
+    {
+        std::cout << g_executable << R"( grep [-F] [-i] [-l] [-j threads] pattern packfile [...packfile]
+
+  Options
+    -F       the pattern is a literal byte string rather than a regular expression
+    -i       ignore case when matching
+    -l       list only the names of the files that match, once each
+    -j       the number of threads to search with. The default is one per hardware thread
+
+  Arguments
+    pattern  The (ECMAScript) regular expression or, with -F, the byte string to search for
+    packfile One or more paths to PACK files whose files should be searched
+
+  Each match is listed as packfile:file:offset, where offset is the byte offset of the match in the file. Matches are
+  listed as they're found, so their order is not defined. The exit code is non-zero if there are no matches.
+
+  Regular expressions are matched against one line at a time, so a match can't span lines. Lines longer than )" << MaxLineLength << R"(
+  bytes are matched in overlapping pieces of that length, so matches longer than )" << LineOverlap << R"( bytes may be missed in them.
+)";
+    }
+
+    /**
+     * Parse the command-line arguments into a set of Options.
+     *
+     * @param args
+     * @return The parsed options.
+     * @throws std::runtime_error if the args are not valid.
+     */
+    Options parseArguments(const ActionArguments & args)
+    {
+        Options opts;
+        bool havePattern = false;
+
+        for (auto it = args.cbegin(); it != args.cend(); ++it) {
+            const auto & arg = *it;
+
+            if ("-F" == arg) {
+                opts.fixedString = true;
+            } else if ("-i" == arg) {
+                opts.ignoreCase = true;
+            } else if ("-l" == arg) {
+                opts.filesWithMatches = true;
+            } else if ("-j" == arg) {
+                if (args.cend() == it + 1) {
+                    throw std::runtime_error(std::format("Expected argument for {}", arg));
+                }
+
+                ++it;
+
+                try {
+                    opts.threads = static_cast<unsigned int>(std::stoul(*it));
+                } catch (const std::logic_error &) {
+                    throw std::runtime_error(std::format("Invalid thread count \"{}\"", *it));
+                }
+            } else if (!havePattern) {
+                opts.pattern = arg;
+                havePattern = true;
+            } else {
+                opts.pacFileNames.push_back(arg);
+            }
+        }
+
+        if (opts.pacFileNames.empty()) {
+            throw std::runtime_error("You must provide the pattern to search for and at least one pac file to search.");
+        }
+
+        if (opts.fixedString && opts.pattern.empty()) {
+            throw std::runtime_error("The byte string to search for can't be empty.");
+        }
+
+        return opts;
+    }
+
+    /**
+     * Find the first occurrence of a literal in some data.
+     *
+     * Where SSE2 is available, the first and last bytes of the literal are compared with 16 positions in the data at
+     * once, and the whole literal is compared only at the positions where both match.
+     *
+     * @return The position of the literal, or std::string_view::npos if it's not found.
+     */
+    std::size_t findLiteral(std::string_view data, std::string_view literal, std::size_t from) noexcept
+    {
+        const auto length = literal.size();
+
+        if (data.size() < length || data.size() - length < from) {
+            return std::string_view::npos;
+        }
+
+#if defined(__SSE2__)
+        if (1 < length) {
+            const auto first = _mm_set1_epi8(literal.front());
+            const auto last = _mm_set1_epi8(literal.back());
+
+            for (; from + length - 1 + sizeof(__m128i) <= data.size(); from += sizeof(__m128i)) {
+                const auto firstBlock = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data.data() + from));
+                const auto lastBlock = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data.data() + from + length - 1));
+                auto candidates = static_cast<unsigned int>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, firstBlock), _mm_cmpeq_epi8(last, lastBlock))));
+
+                while (0 != candidates) {
+                    const auto pos = from + std::countr_zero(candidates);
+
+                    if (0 == std::memcmp(data.data() + pos + 1, literal.data() + 1, length - 2)) {
+                        return pos;
+                    }
+
+                    candidates &= candidates - 1;
+                }
+            }
+        }
+#endif
+
+        return data.find(literal, from);
+    }
+
+    /**
+     * Searches content for the pattern given in the options.
+     *
+     * Literal patterns use findLiteral() unless case is ignored, in which case they're matched as an escaped regular
+     * expression. A searcher can be used by several threads at once.
+     */
+    class Searcher
+    {
+    public:
+        /** @throws std::runtime_error if the pattern is not a valid regular expression. */
+        explicit Searcher(const Options & opts)
+        {
+            if (opts.fixedString && !opts.ignoreCase) {
+                m_literal = opts.pattern;
+                return;
+            }
+
+            auto pattern = opts.pattern;
+
+            if (opts.fixedString) {
+                static const std::regex special(R"([\\^$.|?*+()\[\]{}])");
+                pattern = std::regex_replace(pattern, special, R"(\$&)");
+            }
+
+            try {
+                m_regex.emplace(pattern, std::regex::ECMAScript | std::regex::optimize | (opts.ignoreCase ? std::regex::icase : std::regex::flag_type{}));
+            } catch (const std::regex_error & err) {
+                throw std::runtime_error(std::format("Invalid regular expression \"{}\": {}", opts.pattern, err.what()));
+            }
+        }
+
+        /**
+         * Search some content, calling a function with the offset of each match until it returns false.
+         *
+         * The content can be searched a chunk at a time. A match that might continue past the end of a chunk isn't
+         * reported, and the part of the chunk it would start in is left to be searched again with the next chunk.
+         *
+         * @param content The content to search.
+         * @param start The offset in the content to search from. The content before it has already been searched, and
+         * is kept so that a match at the start can look at the byte before it.
+         * @param isEnd Whether the content runs to the end of the file.
+         * @param onMatch Called with the offset of each match in the content.
+         * @return The offset up to which the content has been searched. The rest must be searched again with the
+         * content that follows it.
+         */
+        std::size_t search(std::string_view content, std::size_t start, bool isEnd, const std::function<bool(std::size_t)> & onMatch) const
+        {
+            if (!m_regex) {
+                for (auto pos = findLiteral(content, m_literal, start); std::string_view::npos != pos; pos = findLiteral(content, m_literal, pos + m_literal.size())) {
+                    if (!onMatch(pos)) {
+                        break;
+                    }
+                }
+
+                // a literal that starts in the last few bytes could be completed by the next chunk
+                return (isEnd ? content.size() : std::max(start, content.size() - std::min(content.size(), m_literal.size() - 1)));
+            }
+
+            std::size_t pos = start;
+
+            while (pos < content.size()) {
+                auto end = content.find('\n', pos);
+                auto next = end + 1;
+
+                // matches from here on in a piece of a long line are left to be found in the next piece
+                auto reportBefore = std::string_view::npos;
+
+                if (std::string_view::npos == end || MaxLineLength < end - pos) {
+                    // a line that isn't complete yet is left for the next chunk, unless it's too long to wait for
+                    if (!isEnd && MaxLineLength > content.size() - pos) {
+                        break;
+                    }
+
+                    end = std::min(content.size(), pos + MaxLineLength);
+                    next = end;
+
+                    if (!isEnd || content.size() != end) {
+                        next = end - LineOverlap;
+                        reportBefore = MaxLineLength - LineOverlap;
+                    }
+                }
+
+                // a piece that continues a long line doesn't start a line, but can look back at the piece before it
+                auto flags = std::regex_constants::match_default;
+
+                if (0 < pos && '\n' != content[pos - 1]) {
+                    flags = std::regex_constants::match_not_bol | std::regex_constants::match_prev_avail;
+                }
+
+                const auto line = content.substr(pos, end - pos);
+                const auto matchEnd = std::cregex_iterator();
+
+                for (auto match = std::cregex_iterator(line.data(), line.data() + line.size(), *m_regex, flags); matchEnd != match; ++match) {
+                    if (reportBefore <= static_cast<std::size_t>(match->position())) {
+                        break;
+                    }
+
+                    if (!onMatch(pos + static_cast<std::size_t>(match->position()))) {
+                        return content.size();
+                    }
+                }
+
+                pos = next;
+            }
+
+            return std::min(pos, content.size());
+        }
+
+    private:
+        std::string m_literal;
+        std::optional<std::regex> m_regex;
+    };
+
+    /**
+     * The state shared by the threads searching the archives.
+     *
+     * Each thread opens the next archive when there are no jobs queued, and queues a job for each run of its files. It
+     * then works on any queued jobs (from any archive) until all its archive's jobs are done, so that the archive stays
+     * open while it's being searched.
+     */
+    struct Search
+    {
+        const Options & opts;
+        const Searcher & searcher;
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<std::function<void()>> jobs;
+        std::size_t nextArchive = 0;
+        int archivesOpening = 0;
+
+        std::mutex outputMutex;
+        std::atomic<bool> matched = false;
+
+        /** Whether any file could be searched, so that failing to read every archive isn't reported as no matches. */
+        std::atomic<bool> searched = false;
+    };
+
+    /**
+     * Search a run of files in an archive, writing matches to stdout.
+     */
+    template<class Reader>
+    void searchFiles(Search & search, const Reader & reader, const std::string & pacFileName, const std::vector<int> & files)
+    {
+        std::string output;
+
+        for (const auto idx : files) {
+            try {
+                auto file = reader.file(idx);
+                const auto fileName = reader.fileName(idx);
+
+                // the file is read and searched a chunk at a time, keeping the part of each chunk that has still to be
+                // searched with the next
+                std::string content;
+                std::size_t contentOffset = 0;
+                std::size_t searched = 0;
+                bool stopped = false;
+
+                const auto onMatch = [&](std::size_t offset) {
+                    if (search.opts.filesWithMatches) {
+                        output += std::format("{}:{}\n", pacFileName, fileName);
+                        stopped = true;
+                        return false;
+                    }
+
+                    output += std::format("{}:{}:{}\n", pacFileName, fileName, contentOffset + offset);
+                    return true;
+                };
+
+                do {
+                    content += file.read(std::min(ChunkSize, file.size() - file.pos()));
+                    searched = search.searcher.search(content, searched, file.eof(), onMatch);
+
+                    // the last byte searched is kept, so that the next chunk knows what comes before it
+                    const auto done = searched - std::min<std::size_t>(searched, 1);
+                    content.erase(0, done);
+                    contentOffset += done;
+                    searched -= done;
+                } while (!stopped && !file.eof());
+
+                search.searched = true;
+            } catch (const std::runtime_error & err) {
+                std::lock_guard lock(search.outputMutex);
+                error(std::format(R"(Failed reading file {} from PACK file "{}": {})", idx, pacFileName, err.what()));
+            }
+        }
+
+        if (!output.empty()) {
+            search.matched = true;
+            std::lock_guard lock(search.outputMutex);
+            std::cout << output << std::flush;
+        }
+    }
+
+    /**
+     * Run queued jobs until a condition is met, waiting for other threads while there are none.
+     *
+     * @param done Called with the search's mutex held.
+     */
+    template<class Predicate>
+    void workUntil(Search & search, Predicate done)
+    {
+        std::unique_lock lock(search.mutex);
+
+        while (!done()) {
+            if (search.jobs.empty()) {
+                search.changed.wait(lock);
+                continue;
+            }
+
+            auto job = std::move(search.jobs.front());
+            search.jobs.pop_front();
+            lock.unlock();
+            job();
+            lock.lock();
+        }
+    }
+
+    /**
+     * Open an archive and search its files, on the thread pool, returning once they've all been searched.
+     */
+    void searchArchive(Search & search, const std::string & pacFileName)
+    {
+        try {
+            withReader(pacFileName, [&](const auto & reader) {
+                // runs of files in the order they're stored, so that each job reads a contiguous part of the archive
+                std::vector<int> files(reader.fileCount());
+                std::iota(files.begin(), files.end(), 0);
+                std::ranges::sort(files, {}, [&reader](int idx) { return static_cast<std::uint32_t>(reader.fileOffset(idx)); });
+                std::size_t pending = 0;
+
+                if (files.empty()) {
+                    search.searched = true;
+                }
+
+                {
+                    std::lock_guard lock(search.mutex);
+
+                    for (auto run = files.cbegin(); run != files.cend();) {
+                        std::size_t runBytes = 0;
+                        auto runEnd = run;
+
+                        while (runEnd != files.cend() && (run == runEnd || JobSize > runBytes)) {
+                            runBytes += static_cast<std::uint32_t>(reader.fileSize(*runEnd));
+                            ++runEnd;
+                        }
+
+                        search.jobs.emplace_back([&search, &reader, &pacFileName, &pending, runFiles = std::vector<int>(run, runEnd)]() {
+                            searchFiles(search, reader, pacFileName, runFiles);
+                            std::lock_guard lock(search.mutex);
+                            --pending;
+                            search.changed.notify_all();
+                        });
+
+                        ++pending;
+                        run = runEnd;
+                    }
+
+                    --search.archivesOpening;
+                }
+
+                search.changed.notify_all();
+                workUntil(search, [&pending]() { return 0 == pending; });
+            });
+
+            return;
+        } catch (const std::exception & err) {
+            std::lock_guard lock(search.outputMutex);
+            error(std::format(R"(Failed reading file "{}": {})", pacFileName, err.what()));
+        }
+
+        // the archive couldn't be opened, so no jobs were queued for it
+        std::lock_guard lock(search.mutex);
+        --search.archivesOpening;
+        search.changed.notify_all();
+    }
+
+    /**
+     * The work of each thread in the pool: search archives, and files from other threads' archives, until there are
+     * none left.
+     */
+    void work(Search & search)
+    {
+        while (true) {
+            std::string pacFileName;
+
+            {
+                std::unique_lock lock(search.mutex);
+                search.changed.wait(lock, [&search]() {
+                    return !search.jobs.empty() || search.nextArchive < search.opts.pacFileNames.size() || 0 == search.archivesOpening;
+                });
+
+                if (search.jobs.empty() && search.nextArchive == search.opts.pacFileNames.size()) {
+                    return;
+                }
+
+                if (search.jobs.empty()) {
+                    pacFileName = search.opts.pacFileNames[search.nextArchive++];
+                    ++search.archivesOpening;
+                }
+            }
+
+            if (pacFileName.empty()) {
+                workUntil(search, [&search]() { return search.jobs.empty(); });
+            } else {
+                searchArchive(search, pacFileName);
+            }
+        }
+    }
+}
+
+
+/**
+ * Search the content of the files in one or more ID PACK archives.
+ *
+ * @param args The command-line arguments provided to the grep action.
+ *
+ * @return ExitCode::Ok if there are any matches, ExitCode::NoMatches if there are none, another ExitCode if the command
+ * is not valid, a negative int if none of the archives' files could be read.
+ */
+int Id::Pack::Tools::PackFile::Actions::grep(const ActionArguments & args) noexcept
+{
+    Options opts;
+    std::optional<Searcher> searcher;
+
+    try {
+        opts = parseArguments(args);
+        searcher.emplace(opts);
+    } catch (const std::runtime_error & err) {
+        error(err.what());
+        usage();
+        return ExitCode::InvalidArgument;
+    }
+
+    Search search{
+        .opts = opts,
+        .searcher = *searcher,
+        .mutex = {},
+        .changed = {},
+        .jobs = {},
+        .nextArchive = 0,
+        .archivesOpening = 0,
+        .outputMutex = {},
+        .matched = false,
+        .searched = false,
+    };
+    const auto threads = (0 == opts.threads ? std::max(1u, std::thread::hardware_concurrency()) : opts.threads);
+
+    {
+        std::vector<std::jthread> workers;
+
+        for (unsigned int thread = 0; thread < threads; ++thread) {
+            workers.emplace_back(work, std::ref(search));
+        }
+    }
+
+    if (search.matched) {
+        return ExitCode::Ok;
+    }
+
+    return (search.searched ? ExitCode::NoMatches : -1);
+}
@@ -0,0 +1,11 @@
+#ifndef TOOLS_PACKFILE_ACTION_GREP_H
+#define TOOLS_PACKFILE_ACTION_GREP_H
+
+#include "../actions.h"
+
+namespace Id::Pack::Tools::PackFile::Actions
+{
+    int grep(const ActionArguments &args) noexcept;
+}
+
+#endif
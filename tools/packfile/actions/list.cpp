@@ -2,8 +2,14 @@
 // Created by darren on 03/04/24.
 //
 
+#include <algorithm>
+#include <bit>
+#include <condition_variable>
 #include <format>
-#include <iomanip>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include "list.h"
 #include "../../output.h"
 #include "../../ExitCode.h"
@@ -12,76 +18,326 @@
 using Id::Pack::Tools::error;
 using Id::Pack::Tools::ExitCode;
 using Id::Pack::Tools::PackFile::ActionArguments;
-using Id::Pack::Reader;
+using Id::Pack::withReader;
 
 extern std::string g_executable;
 
 namespace
 {
+    /** The output formats for listings. */
+    enum class Format
+    {
+        Text,
+        JsonLines,
+        Binary,
+    };
+
+    /**
+     * The options controlling the listing.
+     */
+    struct Options
+    {
+        bool verbose = false;
+        Format format = Format::Text;
+        unsigned int threads = 0;
+        std::vector<std::string> pacFileNames;
+    };
+
+    /** The listing of an archive, or the error that prevented it being listed. */
+    struct Listing
+    {
+        std::string output;
+        std::string error;
+    };
+
+    /** The number of bytes of output buffered before it's written to stdout. */
+    constexpr std::size_t OutputBufferSize = 1024 * 1024;
+
     void usage() noexcept
     {
-        std::cout << std::format(R"(Usage: {} list [-v|--verbose] file [...file]
+        std::cout << std::format(R"(Usage: {} list [-v|--verbose] [--format format] [-j threads] file [...file]
 
   Options
     -v, --verbose
       print verbose output - includes the file index, byte offset and byte size for each file in the archive(s)
+    --format
+      the output format: text (the default), jsonl or binary
+    -j
+      the number of archives to open and index at once. The default is one per hardware thread
 
   Arguments
     file  One or more paths to PACK files whose contents should be listed
+
+  Archives are listed in the order given, whatever order they're indexed in.
+
+  The jsonl format has one object per file, with the members archive, index, name, offset, size, storedSize and
+  codec. The binary format is a sequence of records, each starting with a type byte. An 'A' record starts each
+  archive, followed by the uint32 length of the archive's path and the path; an 'F' record follows for each file in the
+  archive, with the uint32 index, offset, size and stored size, the uint8 codec (0 none, 1 daikatana, 2 zlib, 3 zstd),
+  the uint16 length of the name and the name. All integers are little-endian.
 )", g_executable);
     }
-}
 
+    /**
+     * Parse the command-line arguments into a set of Options.
+     *
+     * @param args
+     * @return The parsed options.
+     * @throws std::runtime_error if the args are not valid.
+     */
+    Options parseArguments(const ActionArguments & args)
+    {
+        Options opts;
 
-int Id::Pack::Tools::PackFile::Actions::list(const ActionArguments & args) noexcept
-{
-    bool verbose = false;
-    ActionArguments::const_iterator it;
+        for (auto it = args.cbegin(); it != args.cend(); ++it) {
+            const auto & arg = *it;
 
-    for (it = args.cbegin(); it != args.cend(); ++it) {
-        const auto & arg = *it;
+            if ("-v" == arg || "--verbose" == arg) {
+                opts.verbose = true;
+            } else if ("--format" == arg || "-j" == arg) {
+                if (args.cend() == it + 1) {
+                    throw std::runtime_error(std::format("Expected argument for {}", arg));
+                }
 
-        if ("-v" == arg || "--verbose" == arg) {
-            verbose = true;
-        } else {
-            break;
+                ++it;
+
+                if ("-j" == arg) {
+                    try {
+                        opts.threads = static_cast<unsigned int>(std::stoul(*it));
+                    } catch (const std::logic_error &) {
+                        throw std::runtime_error(std::format("Invalid thread count \"{}\"", *it));
+                    }
+                } else if ("text" == *it) {
+                    opts.format = Format::Text;
+                } else if ("jsonl" == *it) {
+                    opts.format = Format::JsonLines;
+                } else if ("binary" == *it) {
+                    opts.format = Format::Binary;
+                } else {
+                    throw std::runtime_error(std::format("Unrecognised format \"{}\"", *it));
+                }
+            } else {
+                opts.pacFileNames.push_back(arg);
+            }
         }
+
+        return opts;
     }
 
-    if (it == args.cend()) {
-        error("Missing .pak file name(s)");
-        usage();
-        return ExitCode::MissingArgument;
+    /** Append a string to some JSON output as a JSON string literal. */
+    void appendJsonString(std::string & out, std::string_view str)
+    {
+        out += '"';
+
+        for (const auto ch : str) {
+            if ('"' == ch || '\\' == ch) {
+                out += '\\';
+                out += ch;
+            } else if (0x20 > static_cast<unsigned char>(ch)) {
+                std::format_to(std::back_inserter(out), "\\u{:04x}", static_cast<unsigned char>(ch));
+            } else {
+                out += ch;
+            }
+        }
+
+        out += '"';
     }
 
-    while (it != args.cend()) {
-        try {
-            auto reader = Reader(*it);
+    /** Append a little-endian integer to some binary output. */
+    template<std::integral T>
+    void appendLittle(std::string & out, T value)
+    {
+        if constexpr (std::endian::native != std::endian::little) {
+            value = std::byteswap(value);
+        }
 
-            if (verbose) {
-                // work out how many digits we need for the file index
-                int digits = 1;
-                int count = reader.fileCount();
+        out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
 
-                while (10 < count) {
-                    ++digits;
-                    count /= 10;
+    /**
+     * Produce the listing of an archive, with the reader for its layout.
+     */
+    template<class Reader>
+    std::string listing(const Reader & reader, const std::string & pacFileName, const Options & opts)
+    {
+        std::string out;
+        auto outIt = std::back_inserter(out);
+
+        switch (opts.format) {
+            case Format::Text:
+                if (opts.verbose) {
+                    // work out how many digits we need for the file index
+                    int digits = 1;
+                    int count = reader.fileCount();
+
+                    while (10 < count) {
+                        ++digits;
+                        count /= 10;
+                    }
+
+                    for (int idx = 0; idx < reader.fileCount(); ++idx) {
+                        std::format_to(outIt, "{: >{}}: {} {} bytes @ {:#010x}\n", idx, digits, reader.fileName(idx), reader.fileSize(idx), reader.fileOffset(idx));
+                    }
+                } else {
+                    for (int idx = 0; idx < reader.fileCount(); ++idx) {
+                        out += reader.fileName(idx);
+                        out += '\n';
+                    }
                 }
+                break;
 
+            case Format::JsonLines:
                 for (int idx = 0; idx < reader.fileCount(); ++idx) {
-                    std::cout << std::format("{: >{}}: {} {} bytes @ {:#010x}", idx, digits, reader.fileName(idx), reader.fileSize(idx), reader.fileOffset(idx)) << "\n";
+                    out += R"({"archive":)";
+                    appendJsonString(out, pacFileName);
+                    std::format_to(outIt, R"(,"index":{},"name":)", idx);
+                    appendJsonString(out, reader.fileName(idx));
+                    std::format_to(
+                        outIt,
+                        R"(,"offset":{},"size":{},"storedSize":{},"codec":"{}"}})" "\n",
+                        static_cast<std::uint32_t>(reader.fileOffset(idx)),
+                        static_cast<std::uint32_t>(reader.fileSize(idx)),
+                        static_cast<std::uint32_t>(reader.storedSize(idx)),
+                        Id::Pack::codecName(reader.fileCodec(idx))
+                    );
                 }
-            } else {
+                break;
+
+            case Format::Binary:
+                out += 'A';
+                appendLittle(out, static_cast<std::uint32_t>(pacFileName.size()));
+                out += pacFileName;
+
                 for (int idx = 0; idx < reader.fileCount(); ++idx) {
-                    std::cout << reader.fileName(idx) << "\n";
+                    const auto name = reader.fileName(idx);
+                    out += 'F';
+                    appendLittle(out, static_cast<std::uint32_t>(idx));
+                    appendLittle(out, static_cast<std::uint32_t>(reader.fileOffset(idx)));
+                    appendLittle(out, static_cast<std::uint32_t>(reader.fileSize(idx)));
+                    appendLittle(out, static_cast<std::uint32_t>(reader.storedSize(idx)));
+                    appendLittle(out, static_cast<std::uint8_t>(reader.fileCodec(idx)));
+                    appendLittle(out, static_cast<std::uint16_t>(name.size()));
+                    out += name;
+                }
+                break;
+        }
+
+        return out;
+    }
+}
+
+
+int Id::Pack::Tools::PackFile::Actions::list(const ActionArguments & args) noexcept
+{
+    Options opts;
+
+    try {
+        opts = parseArguments(args);
+    } catch (const std::runtime_error & err) {
+        error(err.what());
+        usage();
+        return ExitCode::InvalidArgument;
+    }
+
+    if (opts.pacFileNames.empty()) {
+        error("Missing .pak file name(s)");
+        usage();
+        return ExitCode::MissingArgument;
+    }
+
+    const auto archiveCount = opts.pacFileNames.size();
+    const auto threads = std::min<std::size_t>(archiveCount, (0 == opts.threads ? std::max(1u, std::thread::hardware_concurrency()) : opts.threads));
+
+    // archives are indexed by the pool at most this far ahead of the one being written, to bound the memory used
+    const auto window = 4 * threads;
+
+    std::vector<std::optional<Listing>> listings(archiveCount);
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::size_t nextArchive = 0;
+    std::size_t nextToWrite = 0;
+
+    const auto work = [&]() {
+        while (true) {
+            std::size_t archive;
+
+            {
+                std::unique_lock lock(mutex);
+                changed.wait(lock, [&]() { return archiveCount == nextArchive || nextArchive < nextToWrite + window; });
+
+                if (archiveCount == nextArchive) {
+                    return;
                 }
+
+                archive = nextArchive++;
             }
-        } catch (const std::runtime_error & err) {
-            error(std::format(R"(Failed reading file "{}": {})", *it, err.what()));
+
+            Listing result;
+            const auto & pacFileName = opts.pacFileNames[archive];
+
+            try {
+                result.output = withReader(pacFileName, [&pacFileName, &opts](const auto & reader) {
+                    return listing(reader, pacFileName, opts);
+                });
+            } catch (const std::runtime_error & err) {
+                result.error = std::format(R"(Failed reading file "{}": {})", pacFileName, err.what());
+            }
+
+            {
+                std::lock_guard lock(mutex);
+                listings[archive] = std::move(result);
+            }
+
+            changed.notify_all();
         }
+    };
+
+    std::vector<std::jthread> workers;
+
+    for (std::size_t thread = 0; thread < threads; ++thread) {
+        workers.emplace_back(work);
+    }
+
+    std::string buffer;
+    buffer.reserve(OutputBufferSize);
+
+    const auto flush = [&buffer]() {
+        std::cout.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    };
 
-        ++it;
+    while (nextToWrite < archiveCount) {
+        Listing result;
+
+        {
+            std::unique_lock lock(mutex);
+            changed.wait(lock, [&]() { return listings[nextToWrite].has_value(); });
+            result = std::move(*listings[nextToWrite]);
+            listings[nextToWrite].reset();
+            ++nextToWrite;
+        }
+
+        changed.notify_all();
+
+        if (!result.error.empty()) {
+            flush();
+            std::cout.flush();
+            error(result.error);
+            continue;
+        }
+
+        if (OutputBufferSize < buffer.size() + result.output.size()) {
+            flush();
+        }
+
+        if (OutputBufferSize <= result.output.size()) {
+            std::cout.write(result.output.data(), static_cast<std::streamsize>(result.output.size()));
+        } else {
+            buffer += result.output;
+        }
     }
 
+    flush();
+    std::cout.flush();
     return ExitCode::Ok;
 }
@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <filesystem>
+#include <format>
+#include <unordered_map>
+#include "reorder.h"
+#include "../../output.h"
+#include "../../ExitCode.h"
+#include "../../../sdk/Reader"
+#include "../../../sdk/Writer"
+
+using Id::Pack::Tools::PackFile::ActionArguments;
+using Id::Pack::Tools::ExitCode;
+using Id::Pack::Tools::error;
+using Id::Pack::Tools::info;
+using Id::Pack::withReader;
+
+extern std::string g_executable;
+
+namespace
+{
+    /**
+     * The options controlling the reordering.
+     */
+    struct Options
+    {
+        bool verbose = false;
+        std::vector<std::string> traceFileNames;
+        std::string pacFileName;
+        std::string outputFileName;
+    };
+
+    /**
+     * Show the usage message for the reorder action.
+     */
+    void usage() noexcept
+    {
+        std::cout << g_executable << R"( reorder [-v] --trace tracefile [--trace tracefile...] packfile output
+
+  Options
+    -v          list the files in their new order
+    --trace     a trace of the accesses to the PACK file, recorded by a reader with startTrace(). More than one trace
+                can be given; files are ordered by their first access in the first trace that records them
+
+  Arguments
+    packfile    The path to the PACK file to reorder
+    output      The path to which to write the reordered PACK file. Any existing file is overwritten
+
+  The reordered PACK file stores the files that were accessed in the order they were first accessed, so that files
+  loaded together are read from adjacent parts of the archive, followed by the files that weren't accessed in the order
+  they were stored. The content of each file is copied as stored, without being decompressed and compressed again.
+
+  Files have different indices in the reordered PACK file, so traces recorded against the original don't apply to it.
+)";
+    }
+
+    /**
+     * Parse the command-line arguments into a set of Options.
+     *
+     * @param args
+     * @return The parsed options.
+     * @throws std::runtime_error if the args are not valid.
+     */
+    Options parseArguments(const ActionArguments & args)
+    {
+        Options opts;
+
+        for (auto it = args.cbegin(); it != args.cend(); ++it) {
+            const auto & arg = *it;
+
+            if ("-v" == arg || "--verbose" == arg) {
+                opts.verbose = true;
+            } else if ("--trace" == arg) {
+                if (args.cend() == it + 1) {
+                    throw std::runtime_error(std::format("Expected argument for {}", arg));
+                }
+
+                ++it;
+                opts.traceFileNames.push_back(*it);
+            } else if (opts.pacFileName.empty()) {
+                opts.pacFileName = arg;
+            } else if (opts.outputFileName.empty()) {
+                opts.outputFileName = arg;
+            } else {
+                throw std::runtime_error(std::format("Unexpected argument \"{}\"", arg));
+            }
+        }
+
+        if (opts.outputFileName.empty()) {
+            throw std::runtime_error("You must provide the pac file to reorder and the file to write.");
+        }
+
+        if (opts.traceFileNames.empty()) {
+            throw std::runtime_error("You must provide at least one trace.");
+        }
+
+        return opts;
+    }
+
+    /**
+     * Work out the order in which to store the files in an archive.
+     *
+     * The files in the traces come first, in first-access order, then the rest in storage order. Where more than one
+     * file has the same name, the files with that name keep their relative order, so the same one is found by name.
+     *
+     * @return The indices of the files, in the order they're to be stored, and the number of them that were traced.
+     */
+    template<class Reader>
+    std::pair<std::vector<int>, std::size_t> storageOrder(const Reader & reader, const Options & opts)
+    {
+        const auto fileCount = reader.fileCount();
+        std::vector<bool> placed(fileCount);
+        std::vector<int> order;
+        order.reserve(fileCount);
+
+        for (const auto & traceFileName : opts.traceFileNames) {
+            for (const auto idx : Id::Pack::AccessTrace::read(traceFileName, reader.traceFingerprint())) {
+                if (!placed[idx]) {
+                    placed[idx] = true;
+                    order.push_back(idx);
+                }
+            }
+        }
+
+        const auto traced = order.size();
+        std::vector<int> untraced;
+
+        for (int idx = 0; idx < fileCount; ++idx) {
+            if (!placed[idx]) {
+                untraced.push_back(idx);
+            }
+        }
+
+        std::ranges::stable_sort(untraced, {}, [&reader](int idx) { return static_cast<std::uint32_t>(reader.fileOffset(idx)); });
+        order.insert(order.end(), untraced.begin(), untraced.end());
+
+        // give the files sharing each name the positions they occupy between them, in their original order
+        std::unordered_map<std::string, std::vector<std::size_t>> positionsByName;
+
+        for (std::size_t position = 0; position < order.size(); ++position) {
+            positionsByName[reader.fileName(order[position])].push_back(position);
+        }
+
+        for (auto & [name, positions] : positionsByName) {
+            if (1 == positions.size()) {
+                continue;
+            }
+
+            std::vector<int> files;
+
+            for (const auto position : positions) {
+                files.push_back(order[position]);
+            }
+
+            std::ranges::sort(files);
+
+            for (std::size_t file = 0; file < files.size(); ++file) {
+                order[positions[file]] = files[file];
+            }
+        }
+
+        return {std::move(order), traced};
+    }
+
+    /**
+     * Write a reordered copy of an archive, with the reader for its layout.
+     */
+    template<class Reader>
+    void reorder(const Reader & reader, const Options & opts)
+    {
+        const auto [order, traced] = storageOrder(reader, opts);
+        Id::Pack::BasicWriter<typename Reader::LayoutType> writer(opts.outputFileName);
+        std::string stored;
+
+        for (const auto idx : order) {
+            const auto name = reader.fileName(idx);
+
+            if (opts.verbose) {
+                std::cout << name << "\n";
+            }
+
+            stored.resize(static_cast<std::uint32_t>(reader.storedSize(idx)));
+            reader.source()->read(static_cast<std::uint32_t>(reader.fileOffset(idx)), stored.data(), stored.size());
+            writer.addStored(name, stored, static_cast<std::uint32_t>(reader.fileSize(idx)), reader.fileCodec(idx));
+        }
+
+        writer.finish();
+        info(std::format(R"(Wrote "{}" with {} file{}, {} of them in traced order)", opts.outputFileName, order.size(), (1 == order.size() ? "" : "s"), traced));
+    }
+}
+
+
+/**
+ * Rewrite an ID PACK archive with its files stored in the order they were accessed in one or more traces.
+ *
+ * @param args The command-line arguments provided to the reorder action.
+ *
+ * @return ExitCode::Ok on success, another ExitCode if the command is not valid, a negative int if something went wrong
+ * trying to reorder the archive.
+ */
+int Id::Pack::Tools::PackFile::Actions::reorder(const ActionArguments & args) noexcept
+{
+    Options opts;
+
+    try {
+        opts = parseArguments(args);
+    } catch (const std::runtime_error & err) {
+        error(err.what());
+        usage();
+        return ExitCode::InvalidArgument;
+    }
+
+    if (std::error_code err; std::filesystem::equivalent(opts.pacFileName, opts.outputFileName, err)) {
+        error("The reordered PACK file must be written to a different file.");
+        return ExitCode::InvalidArgument;
+    }
+
+    try {
+        withReader(opts.pacFileName, [&opts](const auto & reader) {
+            ::reorder(reader, opts);
+        });
+    } catch (const std::exception & err) {
+        error(std::format(R"(Failed reordering PACK file "{}": {})", opts.pacFileName, err.what()));
+        return -1;
+    }
+
+    return ExitCode::Ok;
+}
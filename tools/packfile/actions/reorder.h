@@ -0,0 +1,11 @@
+#ifndef TOOLS_PACKFILE_ACTION_REORDER_H
+#define TOOLS_PACKFILE_ACTION_REORDER_H
+
+#include "../actions.h"
+
+namespace Id::Pack::Tools::PackFile::Actions
+{
+    int reorder(const ActionArguments &args) noexcept;
+}
+
+#endif
@@ -0,0 +1,930 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <format>
+#include <list>
+#include <memory>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <unordered_map>
+#include "serve.h"
+#include "../../output.h"
+#include "../../ExitCode.h"
+#include "../../../sdk/Reader"
+
+using Id::Pack::Tools::PackFile::ActionArguments;
+using Id::Pack::Tools::ExitCode;
+using Id::Pack::Tools::error;
+using Id::Pack::Tools::info;
+
+extern std::string g_executable;
+
+namespace
+{
+    /**
+     * The options controlling the server.
+     */
+    struct Options
+    {
+        bool verbose = false;
+        std::string socketPath;
+        int port = 0;
+        std::vector<std::string> pacFileNames;
+    };
+
+    /** The largest request (line and headers) accepted. */
+    constexpr std::size_t MaxRequestSize = 16 * 1024;
+
+    /** The number of events fetched from epoll at a time. */
+    constexpr int MaxEvents = 64;
+
+    /** The largest number of bytes sent with a single sendfile() call. */
+    constexpr std::size_t MaxSendSize = 1024 * 1024 * 1024;
+
+    /** The most bytes of decompressed file content kept for serving again. */
+    constexpr std::size_t MaxCachedContentSize = 64 * 1024 * 1024;
+
+    /**
+     * Show the usage message for the serve action.
+     */
+    void usage() noexcept
+    {
+        std::cout << g_executable << R"( serve [-v] {--unix path | --port port} packfile [...packfile]
+
+  Options
+    -v        log each request on stderr
+    --unix    listen on a Unix domain socket at the given path. Any existing socket at the path is replaced
+    --port    listen on a TCP port on the loopback interface (127.0.0.1)
+
+  Arguments
+    packfile  One or more paths to PACK files to serve. If more than one contains a file with the same name, the file
+              in the PACK file given last is served, as when later PACK files override earlier ones in a game
+
+  Files are served over HTTP/1.1: GET /name fetches a file, and HEAD /name its size. The server runs until it's sent
+  SIGINT or SIGTERM.
+
+  Requests are handled on a single thread. Compressed files are decompressed on that thread, holding up other requests
+  meanwhile, and the most recently requested )" << MaxCachedContentSize / (1024 * 1024) << R"(MiB of them are kept decompressed to serve again.
+)";
+    }
+
+    /**
+     * Parse the command-line arguments into a set of Options.
+     *
+     * @param args
+     * @return The parsed options.
+     * @throws std::runtime_error if the args are not valid.
+     */
+    Options parseArguments(const ActionArguments & args)
+    {
+        Options opts;
+
+        for (auto it = args.cbegin(); it != args.cend(); ++it) {
+            const auto & arg = *it;
+
+            if ("-v" == arg || "--verbose" == arg) {
+                opts.verbose = true;
+            } else if ("--unix" == arg || "--port" == arg) {
+                if (args.cend() == it + 1) {
+                    throw std::runtime_error(std::format("Expected argument for {}", arg));
+                }
+
+                ++it;
+
+                if ("--unix" == arg) {
+                    opts.socketPath = *it;
+                    continue;
+                }
+
+                try {
+                    opts.port = std::stoi(*it);
+                } catch (const std::logic_error &) {
+                    opts.port = 0;
+                }
+
+                if (0 >= opts.port || 65535 < opts.port) {
+                    throw std::runtime_error(std::format("Invalid port \"{}\"", *it));
+                }
+            } else {
+                opts.pacFileNames.push_back(arg);
+            }
+        }
+
+        if (opts.socketPath.empty() == (0 == opts.port)) {
+            throw std::runtime_error("You must provide exactly one of --unix and --port.");
+        }
+
+        if (opts.pacFileNames.empty()) {
+            throw std::runtime_error("You must provide at least one pac file to serve.");
+        }
+
+        return opts;
+    }
+
+    /**
+     * An open archive, whatever its layout.
+     */
+    class Archive
+    {
+    public:
+        virtual ~Archive() noexcept = default;
+
+        /** @return The source the archive is read from. */
+        virtual const Id::Pack::Source & source() const noexcept = 0;
+
+        /**
+         * @return The (decompressed) content of a file.
+         * @throws std::runtime_error if the content can't be read.
+         */
+        virtual std::string contents(int idx) const = 0;
+    };
+
+    /** An open archive, with the reader for its layout. */
+    template<class Reader>
+    class OpenArchive : public Archive
+    {
+    public:
+        explicit OpenArchive(const std::string & fileName)
+        : m_reader(fileName)
+        {}
+
+        const Reader & reader() const noexcept
+        {
+            return m_reader;
+        }
+
+        const Id::Pack::Source & source() const noexcept override
+        {
+            return *m_reader.source();
+        }
+
+        std::string contents(int idx) const override
+        {
+            auto file = m_reader.file(idx);
+            return file.read(file.size());
+        }
+
+    private:
+        Reader m_reader;
+    };
+
+    /** Where the content of a served file is found. */
+    struct Location
+    {
+        const Archive * archive;
+        int idx;
+        std::uint64_t offset;
+        std::uint64_t size;
+        bool compressed;
+    };
+
+    /** Hashes file names, allowing lookup by std::string_view in a map keyed on std::string. */
+    struct NameHash
+    {
+        using is_transparent = void;
+
+        std::size_t operator()(std::string_view name) const noexcept
+        {
+            return std::hash<std::string_view>{}(name);
+        }
+    };
+
+    /** The files served, keyed by name. */
+    using Index = std::unordered_map<std::string, Location, NameHash, std::equal_to<>>;
+
+    /**
+     * Open an archive with the reader for its layout and add its files to the index.
+     */
+    template<class Reader>
+    std::unique_ptr<Archive> indexArchive(const std::string & fileName, Index & index)
+    {
+        auto archive = std::make_unique<OpenArchive<Reader>>(fileName);
+        const auto & reader = archive->reader();
+
+        for (int idx = 0; idx < reader.fileCount(); ++idx) {
+            index.insert_or_assign(reader.fileName(idx), Location{
+                archive.get(),
+                idx,
+                static_cast<std::uint32_t>(reader.fileOffset(idx)),
+                static_cast<std::uint32_t>(reader.fileSize(idx)),
+                Id::Pack::Codec::None != reader.fileCodec(idx),
+            });
+        }
+
+        return archive;
+    }
+
+    /**
+     * Open an archive with the reader for its format, as withReader() would, and add its files to the index.
+     *
+     * @throws std::runtime_error if the file is not a recognised archive.
+     */
+    std::unique_ptr<Archive> openArchive(const std::string & fileName, Index & index)
+    {
+        const auto id = Id::Pack::formatId(fileName);
+
+        if (Id::Pack::SinLayout::Id == id) {
+            return indexArchive<Id::Pack::SinReader>(fileName, index);
+        }
+
+        if (Id::Pack::ExtendedLayout::Id == id) {
+            return indexArchive<Id::Pack::ExtendedReader>(fileName, index);
+        }
+
+        return indexArchive<Id::Pack::Reader>(fileName, index);
+    }
+
+    /**
+     * Decode the percent-encoded path of a request target to a file name.
+     *
+     * @return The file name, or an empty string if the target is not valid.
+     */
+    std::string fileNameFromTarget(std::string_view target)
+    {
+        if (!target.starts_with('/')) {
+            return {};
+        }
+
+        target = target.substr(1, target.find('?') - 1);
+        std::string name;
+        name.reserve(target.size());
+
+        for (std::size_t pos = 0; pos < target.size(); ++pos) {
+            if ('%' != target[pos]) {
+                name += target[pos];
+                continue;
+            }
+
+            unsigned int byte = 0;
+
+            if (pos + 2 >= target.size() || 1 != std::sscanf(std::string(target.substr(pos + 1, 2)).c_str(), "%2x", &byte)) {
+                return {};
+            }
+
+            name += static_cast<char>(byte);
+            pos += 2;
+        }
+
+        return name;
+    }
+
+    /** Case-insensitive comparison of ASCII strings, as required for HTTP header names and tokens. */
+    bool equalsIgnoringCase(std::string_view lhs, std::string_view rhs) noexcept
+    {
+        return std::ranges::equal(lhs, rhs, [](char lch, char rch) { return std::tolower(static_cast<unsigned char>(lch)) == std::tolower(static_cast<unsigned char>(rch)); });
+    }
+
+    /**
+     * Serves files from an index over HTTP, with an epoll event loop on a single thread.
+     *
+     * Each connection's requests are handled in turn. The response headers (and the content of compressed files) are
+     * written from memory, and the content of uncompressed files is sent straight from the archive with sendfile().
+     * Compressed files are decompressed when they're requested, and kept in a cache of the most recently requested.
+     */
+    class Server
+    {
+    public:
+        /** @throws std::runtime_error if the server can't listen on the socket given in the options. */
+        Server(const Options & opts, const Index & index);
+
+        // Server instances can't be copied or moved
+        Server(const Server &) = delete;
+        Server(Server &&) = delete;
+        void operator = (const Server &) = delete;
+        void operator = (Server &&) = delete;
+        ~Server() noexcept;
+
+        /**
+         * Serve requests until SIGINT or SIGTERM is received.
+         *
+         * @throws std::runtime_error if the event loop fails.
+         */
+        void run();
+
+    private:
+        /** The state of a client connection. */
+        struct Connection
+        {
+            /** Received bytes not yet handled. */
+            std::string input;
+
+            /** The response headers being sent, and how much has been sent. */
+            std::string output;
+            std::size_t outputSent = 0;
+
+            /** The decompressed content being sent, and how much has been sent. */
+            std::shared_ptr<const std::string> content;
+            std::size_t contentSent = 0;
+
+            /** The file descriptor, offset and size of the content being sent from an archive. */
+            int contentFd = -1;
+            std::uint64_t contentOffset = 0;
+            std::uint64_t contentRemaining = 0;
+
+            /** Whether the connection is closed once the current response is sent. */
+            bool closeAfterResponse = false;
+
+            /** Whether the connection is waiting for the socket to become writable. */
+            bool waitingToSend = false;
+
+            /** Whether the client has finished sending, so the connection is closed once its requests are handled. */
+            bool inputClosed = false;
+        };
+
+        /** The result of trying to send a response. */
+        enum class SendResult
+        {
+            Sent,
+            Pending,
+            Closed,
+        };
+
+        /** Accept pending connections. */
+        void accept();
+
+        /** Read from a connection, and handle any complete requests. */
+        void receive(int fd, Connection & connection);
+
+        /** Handle the complete requests received on a connection, until one can't be sent without waiting. */
+        void handleRequests(int fd, Connection & connection);
+
+        /** Build the response to a request. */
+        void respond(Connection & connection, std::string_view request);
+
+        /**
+         * Fetch the decompressed content of a compressed file, from the cache if it's there.
+         *
+         * @throws std::runtime_error if the content can't be read.
+         */
+        std::shared_ptr<const std::string> decompressed(const Location & location);
+
+        /** Set a connection's response to an error. */
+        static void respondWithError(Connection & connection, int status, std::string_view reason);
+
+        /** Send as much of a connection's response as can be sent without waiting. */
+        SendResult send(int fd, Connection & connection);
+
+        /** Set the events a connection is waiting for. */
+        void waitToSend(int fd, Connection & connection, bool waitingToSend);
+
+        /** Close a connection. */
+        void close(int fd);
+
+        /** Close all connections and stop listening. */
+        void stop() noexcept;
+
+        const Options & m_opts;
+        const Index & m_index;
+        int m_listenFd = -1;
+        int m_epollFd = -1;
+        int m_signalFd = -1;
+        bool m_socketBound = false;
+        std::unordered_map<int, Connection> m_connections;
+
+        /** A file's decompressed content, kept to be served again. */
+        struct CachedContent
+        {
+            const Location * location;
+            std::shared_ptr<const std::string> content;
+        };
+
+        /** The decompressed content kept, least recently requested first, with where each file's is and their total size. */
+        std::list<CachedContent> m_contentCache;
+        std::unordered_map<const Location *, std::list<CachedContent>::iterator> m_cachedContent;
+        std::size_t m_cachedContentSize = 0;
+    };
+
+
+    Server::Server(const Options & opts, const Index & index)
+    : m_opts(opts),
+      m_index(index)
+    {
+        const auto fail = [this](std::string_view what) {
+            const auto message = std::format("Error {}: {}", what, std::strerror(errno));
+            stop();
+            throw std::runtime_error(message);
+        };
+
+        if (!opts.socketPath.empty()) {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+
+            if (sizeof(address.sun_path) <= opts.socketPath.size()) {
+                throw std::runtime_error(std::format(R"(Socket path "{}" is too long)", opts.socketPath));
+            }
+
+            opts.socketPath.copy(address.sun_path, sizeof(address.sun_path) - 1);
+
+            // replace a socket left behind by a previous server, but nothing else
+            if (struct stat info{}; 0 == ::lstat(opts.socketPath.c_str(), &info) && S_ISSOCK(info.st_mode)) {
+                ::unlink(opts.socketPath.c_str());
+            }
+
+            m_listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+            if (0 > m_listenFd || 0 != ::bind(m_listenFd, reinterpret_cast<const sockaddr *>(&address), sizeof(address))) {
+                fail(std::format(R"(listening on "{}")", opts.socketPath));
+            }
+
+            m_socketBound = true;
+        } else {
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(static_cast<std::uint16_t>(opts.port));
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            m_listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            const int reuse = 1;
+
+            if (0 > m_listenFd
+                || 0 != ::setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse))
+                || 0 != ::bind(m_listenFd, reinterpret_cast<const sockaddr *>(&address), sizeof(address))) {
+                fail(std::format("listening on port {}", opts.port));
+            }
+        }
+
+        if (0 != ::listen(m_listenFd, SOMAXCONN)) {
+            fail("listening");
+        }
+
+        // the signals that stop the server are handled in the event loop
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        ::sigprocmask(SIG_BLOCK, &signals, nullptr);
+        ::signal(SIGPIPE, SIG_IGN);
+        m_signalFd = ::signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+        m_epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+
+        if (0 > m_signalFd || 0 > m_epollFd) {
+            fail("starting the event loop");
+        }
+
+        for (const auto fd : {m_listenFd, m_signalFd}) {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+
+            if (0 != ::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event)) {
+                fail("starting the event loop");
+            }
+        }
+    }
+
+
+    Server::~Server() noexcept
+    {
+        stop();
+    }
+
+
+    void Server::stop() noexcept
+    {
+        for (const auto & [fd, connection] : m_connections) {
+            ::close(fd);
+        }
+
+        m_connections.clear();
+
+        for (auto * fd : {&m_listenFd, &m_epollFd, &m_signalFd}) {
+            if (0 <= *fd) {
+                ::close(*fd);
+                *fd = -1;
+            }
+        }
+
+        if (m_socketBound) {
+            ::unlink(m_opts.socketPath.c_str());
+            m_socketBound = false;
+        }
+    }
+
+
+    void Server::run()
+    {
+        epoll_event events[MaxEvents];
+
+        while (true) {
+            const auto eventCount = ::epoll_wait(m_epollFd, events, MaxEvents, -1);
+
+            if (0 > eventCount && EINTR == errno) {
+                continue;
+            }
+
+            if (0 > eventCount) {
+                throw std::runtime_error(std::format("Error waiting for events: {}", std::strerror(errno)));
+            }
+
+            for (int idx = 0; idx < eventCount; ++idx) {
+                const auto fd = events[idx].data.fd;
+
+                if (fd == m_signalFd) {
+                    return;
+                }
+
+                if (fd == m_listenFd) {
+                    accept();
+                    continue;
+                }
+
+                const auto connection = m_connections.find(fd);
+
+                if (m_connections.end() == connection) {
+                    continue;
+                }
+
+                if (0 != (events[idx].events & (EPOLLERR | EPOLLHUP)) && 0 == (events[idx].events & EPOLLIN)) {
+                    close(fd);
+                } else if (connection->second.waitingToSend) {
+                    if (SendResult::Sent == send(fd, connection->second)) {
+                        handleRequests(fd, connection->second);
+                    }
+                } else {
+                    receive(fd, connection->second);
+                }
+            }
+        }
+    }
+
+
+    void Server::accept()
+    {
+        while (true) {
+            const auto fd = ::accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+            if (0 > fd) {
+                // EAGAIN means there are no more pending connections; other errors affect only the one connection
+                return;
+            }
+
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+
+            if (0 != ::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event)) {
+                ::close(fd);
+                continue;
+            }
+
+            m_connections.try_emplace(fd);
+        }
+    }
+
+
+    void Server::receive(int fd, Connection & connection)
+    {
+        char buffer[4096];
+
+        // no more is read than can be a single request; anything more is left in the socket until the requests already
+        // received have been handled
+        while (MaxRequestSize >= connection.input.size()) {
+            const auto received = ::recv(fd, buffer, sizeof(buffer), 0);
+
+            if (0 > received && EINTR == errno) {
+                continue;
+            }
+
+            if (0 > received && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+                break;
+            }
+
+            if (0 > received) {
+                close(fd);
+                return;
+            }
+
+            // requests received before the client finished sending are still answered
+            if (0 == received) {
+                connection.inputClosed = true;
+                break;
+            }
+
+            connection.input.append(buffer, received);
+        }
+
+        handleRequests(fd, connection);
+    }
+
+
+    void Server::handleRequests(int fd, Connection & connection)
+    {
+        while (true) {
+            const auto end = connection.input.find("\r\n\r\n");
+
+            if (std::string::npos == end) {
+                if (MaxRequestSize < connection.input.size()) {
+                    respondWithError(connection, 431, "Request Header Fields Too Large");
+                    connection.closeAfterResponse = true;
+                    connection.input.clear();
+                } else if (connection.inputClosed) {
+                    close(fd);
+                    return;
+                } else {
+                    return;
+                }
+            } else {
+                respond(connection, std::string_view(connection.input).substr(0, end + 2));
+                connection.input.erase(0, end + 4);
+            }
+
+            if (SendResult::Sent != send(fd, connection)) {
+                return;
+            }
+        }
+    }
+
+
+    void Server::respond(Connection & connection, std::string_view request)
+    {
+        const auto lineEnd = request.find("\r\n");
+        const auto requestLine = request.substr(0, lineEnd);
+        const auto methodEnd = requestLine.find(' ');
+        const auto targetEnd = requestLine.rfind(' ');
+
+        if (std::string_view::npos == methodEnd || methodEnd == targetEnd || !requestLine.substr(targetEnd + 1).starts_with("HTTP/1.")) {
+            respondWithError(connection, 400, "Bad Request");
+            connection.closeAfterResponse = true;
+            return;
+        }
+
+        const auto method = requestLine.substr(0, methodEnd);
+        const auto target = requestLine.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+
+        // HTTP/1.0 connections close after each response unless the client asks otherwise, HTTP/1.1 ones the reverse
+        connection.closeAfterResponse = requestLine.ends_with("HTTP/1.0");
+
+        for (auto headers = request.substr(lineEnd + 2); !headers.empty();) {
+            const auto header = headers.substr(0, headers.find("\r\n"));
+            headers.remove_prefix(std::min(headers.size(), header.size() + 2));
+            const auto colon = header.find(':');
+
+            if (std::string_view::npos == colon) {
+                continue;
+            }
+
+            const auto name = header.substr(0, colon);
+            auto value = header.substr(colon + 1);
+            value.remove_prefix(std::min(value.size(), value.find_first_not_of(" \t")));
+
+            if (equalsIgnoringCase(name, "Connection")) {
+                connection.closeAfterResponse = !equalsIgnoringCase(value, "keep-alive") && (connection.closeAfterResponse || equalsIgnoringCase(value, "close"));
+            } else if ((equalsIgnoringCase(name, "Content-Length") && "0" != value) || equalsIgnoringCase(name, "Transfer-Encoding")) {
+                // requests with content aren't supported, and the content can't be skipped reliably
+                respondWithError(connection, 400, "Bad Request");
+                connection.closeAfterResponse = true;
+                return;
+            }
+        }
+
+        const auto head = ("HEAD" == method);
+
+        if ("GET" != method && !head) {
+            respondWithError(connection, 405, "Method Not Allowed");
+            return;
+        }
+
+        const auto fileName = fileNameFromTarget(target);
+        const auto location = m_index.find(std::string_view(fileName));
+
+        if (fileName.empty() || m_index.end() == location) {
+            if (m_opts.verbose) {
+                error(std::format("{} {} 404", method, target));
+            }
+
+            respondWithError(connection, 404, "Not Found");
+            return;
+        }
+
+        const auto & [archive, idx, offset, size, compressed] = location->second;
+        std::shared_ptr<const std::string> content;
+
+        if (compressed && !head) {
+            try {
+                content = decompressed(location->second);
+            } catch (const std::runtime_error & err) {
+                error(std::format(R"(Failed reading file "{}": {})", fileName, err.what()));
+                respondWithError(connection, 500, "Internal Server Error");
+                return;
+            }
+        }
+
+        if (m_opts.verbose) {
+            error(std::format("{} {} 200 {}", method, target, size));
+        }
+
+        connection.output = std::format(
+            "HTTP/1.1 200 OK\r\nContent-Length: {}\r\nContent-Type: application/octet-stream\r\nConnection: {}\r\n\r\n",
+            size,
+            (connection.closeAfterResponse ? "close" : "keep-alive")
+        );
+
+        if (head) {
+            return;
+        }
+
+        if (compressed) {
+            connection.content = std::move(content);
+            connection.contentSent = 0;
+        } else {
+            connection.contentFd = archive->source().fileDescriptor();
+            connection.contentOffset = offset;
+            connection.contentRemaining = size;
+        }
+    }
+
+
+    std::shared_ptr<const std::string> Server::decompressed(const Location & location)
+    {
+        if (const auto cached = m_cachedContent.find(&location); m_cachedContent.end() != cached) {
+            m_contentCache.splice(m_contentCache.end(), m_contentCache, cached->second);
+            return cached->second->content;
+        }
+
+        auto content = std::make_shared<const std::string>(location.archive->contents(location.idx));
+
+        if (MaxCachedContentSize < content->size()) {
+            return content;
+        }
+
+        m_cachedContent.emplace(&location, m_contentCache.insert(m_contentCache.end(), {&location, content}));
+        m_cachedContentSize += content->size();
+
+        while (MaxCachedContentSize < m_cachedContentSize) {
+            m_cachedContentSize -= m_contentCache.front().content->size();
+            m_cachedContent.erase(m_contentCache.front().location);
+            m_contentCache.pop_front();
+        }
+
+        return content;
+    }
+
+
+    void Server::respondWithError(Connection & connection, int status, std::string_view reason)
+    {
+        connection.output = std::format(
+            "HTTP/1.1 {} {}\r\nContent-Length: {}\r\nContent-Type: text/plain\r\nConnection: {}\r\n\r\n{}\n",
+            status,
+            reason,
+            reason.size() + 1,
+            (connection.closeAfterResponse ? "close" : "keep-alive"),
+            reason
+        );
+    }
+
+
+    Server::SendResult Server::send(int fd, Connection & connection)
+    {
+        while (connection.outputSent < connection.output.size()) {
+            const auto sent = ::send(fd, connection.output.data() + connection.outputSent, connection.output.size() - connection.outputSent, MSG_NOSIGNAL);
+
+            if (0 > sent && EINTR == errno) {
+                continue;
+            }
+
+            if (0 > sent && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+                waitToSend(fd, connection, true);
+                return SendResult::Pending;
+            }
+
+            if (0 > sent) {
+                close(fd);
+                return SendResult::Closed;
+            }
+
+            connection.outputSent += sent;
+        }
+
+        while (connection.content && connection.contentSent < connection.content->size()) {
+            const auto sent = ::send(fd, connection.content->data() + connection.contentSent, connection.content->size() - connection.contentSent, MSG_NOSIGNAL);
+
+            if (0 > sent && EINTR == errno) {
+                continue;
+            }
+
+            if (0 > sent && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+                waitToSend(fd, connection, true);
+                return SendResult::Pending;
+            }
+
+            if (0 > sent) {
+                close(fd);
+                return SendResult::Closed;
+            }
+
+            connection.contentSent += sent;
+        }
+
+        while (0 < connection.contentRemaining) {
+            auto offset = static_cast<off_t>(connection.contentOffset);
+            const auto sent = ::sendfile(fd, connection.contentFd, &offset, std::min<std::uint64_t>(connection.contentRemaining, MaxSendSize));
+
+            if (0 > sent && EINTR == errno) {
+                continue;
+            }
+
+            if (0 > sent && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+                waitToSend(fd, connection, true);
+                return SendResult::Pending;
+            }
+
+            if (0 >= sent) {
+                // the archive is unreadable or truncated; the response can't be completed
+                close(fd);
+                return SendResult::Closed;
+            }
+
+            connection.contentOffset += sent;
+            connection.contentRemaining -= sent;
+        }
+
+        connection.output.clear();
+        connection.outputSent = 0;
+        connection.content.reset();
+        connection.contentSent = 0;
+
+        if (connection.closeAfterResponse) {
+            close(fd);
+            return SendResult::Closed;
+        }
+
+        waitToSend(fd, connection, false);
+        return SendResult::Sent;
+    }
+
+
+    void Server::waitToSend(int fd, Connection & connection, bool waitingToSend)
+    {
+        if (connection.waitingToSend == waitingToSend) {
+            return;
+        }
+
+        // while a response is being sent the connection waits only to send, so requests are handled one at a time
+        epoll_event event{};
+        event.events = (waitingToSend ? EPOLLOUT : EPOLLIN);
+        event.data.fd = fd;
+        ::epoll_ctl(m_epollFd, EPOLL_CTL_MOD, fd, &event);
+        connection.waitingToSend = waitingToSend;
+    }
+
+
+    void Server::close(int fd)
+    {
+        ::epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        m_connections.erase(fd);
+    }
+}
+
+
+/**
+ * Serve the files in one or more ID PACK archives over HTTP.
+ *
+ * @param args The command-line arguments provided to the serve action.
+ *
+ * @return ExitCode::Ok when the server is stopped, another ExitCode if the command is not valid, a negative int if
+ * something went wrong trying to serve the archives.
+ */
+int Id::Pack::Tools::PackFile::Actions::serve(const ActionArguments & args) noexcept
+{
+    Options opts;
+
+    try {
+        opts = parseArguments(args);
+    } catch (const std::runtime_error & err) {
+        error(err.what());
+        usage();
+        return ExitCode::InvalidArgument;
+    }
+
+    Index index;
+    std::vector<std::unique_ptr<Archive>> archives;
+
+    for (const auto & pacFileName : opts.pacFileNames) {
+        try {
+            archives.push_back(openArchive(pacFileName, index));
+        } catch (const std::exception & err) {
+            error(std::format(R"(Failed reading PACK file "{}": {})", pacFileName, err.what()));
+            return -1;
+        }
+    }
+
+    try {
+        Server server(opts, index);
+        info(std::format("Serving {} file{} from {} PACK file{}", index.size(), (1 == index.size() ? "" : "s"), archives.size(), (1 == archives.size() ? "" : "s")));
+        std::cout.flush();
+        server.run();
+    } catch (const std::exception & err) {
+        error(err.what());
+        return -1;
+    }
+
+    return ExitCode::Ok;
+}
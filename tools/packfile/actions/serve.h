@@ -0,0 +1,11 @@
+#ifndef TOOLS_PACKFILE_ACTION_SERVE_H
+#define TOOLS_PACKFILE_ACTION_SERVE_H
+
+#include "../actions.h"
+
+namespace Id::Pack::Tools::PackFile::Actions
+{
+    int serve(const ActionArguments &args) noexcept;
+}
+
+#endif
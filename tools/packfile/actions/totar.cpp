@@ -0,0 +1,361 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <format>
+#include <map>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "totar.h"
+#include "../../output.h"
+#include "../../ExitCode.h"
+#include "../../../sdk/Reader"
+
+using Id::Pack::Tools::PackFile::ActionArguments;
+using Id::Pack::Tools::ExitCode;
+using Id::Pack::Tools::error;
+using Id::Pack::withReader;
+
+extern std::string g_executable;
+
+namespace
+{
+    /**
+     * The options controlling the conversion.
+     */
+    struct Options
+    {
+        bool verbose = false;
+        bool dropBehind = false;
+        std::string pacFileName;
+    };
+
+    /** The size of a tar block. Headers occupy one block and content is padded to a whole number of blocks. */
+    constexpr std::size_t BlockSize = 512;
+
+    /** The number of bytes copied at a time when content can't be moved by the kernel. */
+    constexpr std::size_t CopySize = 1024 * 1024;
+
+    /**
+     * Show the usage message for the totar action.
+     */
+    void usage() noexcept
+    {
+        std::cout << g_executable << R"( totar [-v] [--drop-behind] packfile
+
+  Options
+    -v             list the files on stderr as they're written
+    --drop-behind  release the PACK file's content from the page cache once it's been written, so that converting a
+                   large PACK file doesn't evict other processes' cached files
+
+  Arguments
+    packfile  The path to the PACK file to convert
+
+  The files in the PACK file are written to stdout as a POSIX (ustar) tar stream, in the order they're stored. If more
+  than one file has the same name, only the last is written, consistent with lookups by name. Where stdout is a pipe or
+  a file, uncompressed content is moved from the PACK file by the kernel (with splice() or sendfile()) without being
+  copied through the tool.
+)";
+    }
+
+    /**
+     * Parse the command-line arguments into a set of Options.
+     *
+     * @param args
+     * @return The parsed options.
+     * @throws std::runtime_error if the args are not valid.
+     */
+    Options parseArguments(const ActionArguments & args)
+    {
+        Options opts;
+
+        for (const auto & arg : args) {
+            if ("-v" == arg || "--verbose" == arg) {
+                opts.verbose = true;
+            } else if ("--drop-behind" == arg) {
+                opts.dropBehind = true;
+            } else if (opts.pacFileName.empty()) {
+                opts.pacFileName = arg;
+            } else {
+                throw std::runtime_error(std::format("Unexpected argument \"{}\"", arg));
+            }
+        }
+
+        if (opts.pacFileName.empty()) {
+            throw std::runtime_error("You must provide the pac file to convert.");
+        }
+
+        return opts;
+    }
+
+    /**
+     * Write all of some data to a file descriptor.
+     *
+     * @throws std::runtime_error if the data can't be written.
+     */
+    void writeAll(int fd, std::string_view data)
+    {
+        while (!data.empty()) {
+            const auto written = ::write(fd, data.data(), data.size());
+
+            if (0 > written && EINTR == errno) {
+                continue;
+            }
+
+            if (0 > written) {
+                throw std::runtime_error(std::format("Error writing tar stream: {}", std::strerror(errno)));
+            }
+
+            data.remove_prefix(written);
+        }
+    }
+
+    /** Write a value as a NUL-terminated octal number filling a header field. */
+    void writeOctal(char * field, std::size_t fieldSize, std::uint64_t value)
+    {
+        std::format("{:0{}o}", value, fieldSize - 1).copy(field, fieldSize - 1);
+    }
+
+    /** Set the checksum of a header, computed with its checksum field filled with spaces. */
+    void writeChecksum(char * header)
+    {
+        std::memset(header + 148, ' ', 8);
+        unsigned int checksum = 0;
+
+        for (std::size_t idx = 0; idx < BlockSize; ++idx) {
+            checksum += static_cast<unsigned char>(header[idx]);
+        }
+
+        std::format("{:06o}", checksum).copy(header + 148, 7);
+        header[154] = '\0';
+    }
+
+    /**
+     * Build a ustar header.
+     *
+     * @return The header, or an empty string if the name can't be represented in a ustar header.
+     */
+    std::string ustarHeader(std::string_view name, std::uint64_t size, std::int64_t modified, char type)
+    {
+        std::string_view prefix;
+
+        if (100 < name.size()) {
+            // split the name between the prefix and name fields at a separator
+            const auto separator = name.find('/', name.size() - 101);
+
+            if (std::string_view::npos == separator || 155 < separator || 0 == separator) {
+                return {};
+            }
+
+            prefix = name.substr(0, separator);
+            name = name.substr(separator + 1);
+        }
+
+        std::string header(BlockSize, '\0');
+        name.copy(header.data(), 100);
+        writeOctal(header.data() + 100, 8, 0644);
+        writeOctal(header.data() + 108, 8, 0);
+        writeOctal(header.data() + 116, 8, 0);
+        writeOctal(header.data() + 124, 12, size);
+        writeOctal(header.data() + 136, 12, static_cast<std::uint64_t>(std::max<std::int64_t>(0, modified)));
+        header[156] = type;
+        std::memcpy(header.data() + 257, "ustar", 6);
+        std::memcpy(header.data() + 263, "00", 2);
+        prefix.copy(header.data() + 345, 155);
+        writeChecksum(header.data());
+        return header;
+    }
+
+    /** The padding required after some content to complete its last block. */
+    std::string_view padding(std::uint64_t size)
+    {
+        static const std::string zeroes(BlockSize, '\0');
+        return std::string_view(zeroes).substr(0, (BlockSize - size % BlockSize) % BlockSize);
+    }
+
+    /**
+     * Build the header(s) for a file.
+     *
+     * Names that don't fit a ustar header are given in a preceding pax extended header.
+     */
+    std::string fileHeader(const std::string & name, std::uint64_t size, std::int64_t modified)
+    {
+        if (auto header = ustarHeader(name, size, modified, '0'); !header.empty()) {
+            return header;
+        }
+
+        // the length of a pax record includes the digits of the length itself
+        const auto recordBody = std::format(" path={}\n", name);
+        auto length = recordBody.size() + 1;
+
+        while (std::to_string(length).size() + recordBody.size() != length) {
+            ++length;
+        }
+
+        const auto record = std::format("{}{}", length, recordBody);
+        auto header = ustarHeader("PaxHeader", record.size(), modified, 'x');
+        header += record;
+        header += padding(record.size());
+        header += ustarHeader(std::string_view(name).substr(name.size() - 100), size, modified, '0');
+        return header;
+    }
+
+    /**
+     * Move content from a file to stdout.
+     *
+     * The kernel moves the content where it can: with splice() when stdout is a pipe, or sendfile() otherwise. Where
+     * it can't (for example if stdout is a socket on an older kernel) the content is copied.
+     *
+     * @throws std::runtime_error if the content can't be read or written.
+     */
+    void moveContent(const Id::Pack::Source & source, std::uint64_t offset, std::uint64_t size, bool outputIsPipe, std::string & buffer)
+    {
+        const auto inFd = source.fileDescriptor();
+
+        while (0 <= inFd && 0 < size) {
+            auto inOffset = static_cast<off_t>(offset);
+            const auto moved = (
+                outputIsPipe
+                ? ::splice(inFd, &inOffset, STDOUT_FILENO, nullptr, size, SPLICE_F_MOVE | SPLICE_F_MORE)
+                : ::sendfile(STDOUT_FILENO, inFd, &inOffset, size)
+            );
+
+            if (0 > moved && EINTR == errno) {
+                continue;
+            }
+
+            if (0 > moved && (EINVAL == errno || ENOSYS == errno)) {
+                break;
+            }
+
+            if (0 > moved) {
+                throw std::runtime_error(std::format("Error writing tar stream: {}", std::strerror(errno)));
+            }
+
+            if (0 == moved) {
+                throw std::runtime_error("Error reading archive: unexpected end of file");
+            }
+
+            offset += moved;
+            size -= moved;
+        }
+
+        while (0 < size) {
+            const auto bytes = std::min<std::uint64_t>(size, CopySize);
+            buffer.resize(bytes);
+            source.read(offset, buffer.data(), bytes);
+            writeAll(STDOUT_FILENO, buffer);
+            offset += bytes;
+            size -= bytes;
+        }
+    }
+
+    /**
+     * Convert an archive to a tar stream on stdout, with the reader for its layout.
+     */
+    template<class Reader>
+    void toTar(const Reader & reader, const Options & opts)
+    {
+        // the files are given the modification time of the archive
+        struct stat archiveInfo{};
+        const std::int64_t modified = (0 == ::stat(opts.pacFileName.c_str(), &archiveInfo) ? archiveInfo.st_mtime : 0);
+
+        // only the last file with any given name is written, and files are written in the order they're stored
+        std::map<std::string, int> filesByName;
+
+        for (int idx = 0; idx < reader.fileCount(); ++idx) {
+            filesByName.insert_or_assign(reader.fileName(idx), idx);
+        }
+
+        std::vector<std::pair<const std::string *, int>> files;
+
+        for (const auto & [name, idx] : filesByName) {
+            const auto path = std::filesystem::path(name);
+
+            // check every name before writing anything, rather than abandoning a partial stream
+            if (name.empty() || path.is_absolute() || std::ranges::any_of(path, [](const auto & part) { return ".." == part; })) {
+                throw std::runtime_error(std::format("File name \"{}\" can't be written safely to a tar stream", name));
+            }
+
+            files.emplace_back(&name, idx);
+        }
+
+        std::ranges::sort(files, {}, [&reader](const auto & file) { return static_cast<std::uint32_t>(reader.fileOffset(file.second)); });
+
+        struct stat outInfo{};
+        const auto outputIsPipe = (0 == ::fstat(STDOUT_FILENO, &outInfo) && S_ISFIFO(outInfo.st_mode));
+        const auto pageSize = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+        std::string buffer;
+        reader.advise(Id::Pack::AccessHint::Sequential);
+
+        for (const auto & [name, idx] : files) {
+            const std::uint64_t size = static_cast<std::uint32_t>(reader.fileSize(idx));
+
+            if (opts.verbose) {
+                error(*name);
+            }
+
+            writeAll(STDOUT_FILENO, fileHeader(*name, size, modified));
+
+            if (Id::Pack::Codec::None != reader.fileCodec(idx)) {
+                auto file = reader.file(idx);
+                writeAll(STDOUT_FILENO, file.read(file.size()));
+            } else {
+                moveContent(*reader.source(), static_cast<std::uint32_t>(reader.fileOffset(idx)), size, outputIsPipe, buffer);
+            }
+
+            writeAll(STDOUT_FILENO, padding(size));
+
+            if (opts.dropBehind) {
+                // include the page the content starts in, which the previous file's hint kept as it was only partly
+                // within that file
+                const std::uint64_t offset = static_cast<std::uint32_t>(reader.fileOffset(idx));
+                const auto dropStart = offset - offset % pageSize;
+                reader.source()->advise(dropStart, offset + static_cast<std::uint32_t>(reader.storedSize(idx)) - dropStart, Id::Pack::AccessHint::DontNeed);
+            }
+        }
+
+        // the end of the archive is marked by two zero blocks
+        writeAll(STDOUT_FILENO, std::string(2 * BlockSize, '\0'));
+    }
+}
+
+
+/**
+ * Convert an ID PACK archive to a tar stream on stdout.
+ *
+ * @param args The command-line arguments provided to the totar action.
+ *
+ * @return ExitCode::Ok on success, another ExitCode if the command is not valid, a negative int if something went wrong
+ * trying to convert the archive.
+ */
+int Id::Pack::Tools::PackFile::Actions::toTar(const ActionArguments & args) noexcept
+{
+    Options opts;
+
+    try {
+        opts = parseArguments(args);
+    } catch (const std::runtime_error & err) {
+        error(err.what());
+        usage();
+        return ExitCode::InvalidArgument;
+    }
+
+    if (::isatty(STDOUT_FILENO)) {
+        error("Refusing to write a tar stream to a terminal - redirect stdout to a file or pipe.");
+        return ExitCode::InvalidArgument;
+    }
+
+    try {
+        withReader(opts.pacFileName, [&opts](const auto & reader) {
+            ::toTar(reader, opts);
+        });
+    } catch (const std::exception & err) {
+        error(std::format(R"(Failed converting PACK file "{}": {})", opts.pacFileName, err.what()));
+        return -1;
+    }
+
+    return ExitCode::Ok;
+}
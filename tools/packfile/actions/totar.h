@@ -0,0 +1,11 @@
+#ifndef TOOLS_PACKFILE_ACTION_TOTAR_H
+#define TOOLS_PACKFILE_ACTION_TOTAR_H
+
+#include "../actions.h"
+
+namespace Id::Pack::Tools::PackFile::Actions
+{
+    int toTar(const ActionArguments &args) noexcept;
+}
+
+#endif
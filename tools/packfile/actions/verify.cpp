@@ -0,0 +1,474 @@
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <thread>
+#include "verify.h"
+#include "../../output.h"
+#include "../../ExitCode.h"
+#include "../../../sdk/Hash"
+#include "../../../sdk/Reader"
+
+using Id::Pack::Tools::PackFile::ActionArguments;
+using Id::Pack::Tools::ExitCode;
+using Id::Pack::Tools::error;
+using Id::Pack::Tools::info;
+using Id::Pack::withReader;
+
+extern std::string g_executable;
+
+namespace
+{
+    /** The checksum algorithms available for verifying file content. */
+    enum class Algorithm
+    {
+        None,
+        Xxh64,
+        Crc32c,
+    };
+
+    /**
+     * The options controlling the verification.
+     */
+    struct Options
+    {
+        bool verbose = false;
+        unsigned int threads = 0;
+        Algorithm algorithm = Algorithm::None;
+        std::string manifest;
+        std::string writeManifest;
+        std::vector<std::string> pacFileNames;
+    };
+
+    /** The expected checksum of each file, keyed by file name. */
+    using Manifest = std::map<std::string, std::string, std::less<>>;
+
+    /** The byte size of the header of a PACK archive. */
+    constexpr std::uint64_t HeaderSize = 12;
+
+    /** The number of bytes of a file each thread reads at a time when computing checksums. */
+    constexpr std::size_t ChunkSize = 1024 * 1024;
+
+    /**
+     * Show the usage message for the verify action.
+     */
+    void usage() noexcept
+    {
+        std::cout << g_executable << R"( verify [-v] [-j threads] [--checksums algorithm] [--manifest file] [--write-manifest file] packfile [...packfile]
+
+  Options
+    -v                print verbose output
+    -j                the number of threads to compute checksums with. The default is one per hardware thread
+    --checksums       compute a checksum of the stored content of each file: xxh64 or crc32c
+    --manifest        compare the checksums with those in a manifest file, as written by --write-manifest. The algorithm
+                      is inferred from the manifest if --checksums is not given
+    --write-manifest  write the checksums to a manifest file, one "checksum  name" line per file. Defaults to xxh64
+                      checksums if --checksums is not given
+
+  Arguments
+    packfile          One or more paths to PACK files to verify. Only one can be given with --manifest or
+                      --write-manifest
+
+  The index of each archive is checked for entries outside the archive, entries overlapping the index, invalid names
+  and unknown codecs. The exit code is non-zero if any problem is found.
+)";
+    }
+
+    /**
+     * Parse a checksum algorithm name.
+     *
+     * @throws std::runtime_error if the name is not a recognised algorithm.
+     */
+    Algorithm parseAlgorithm(const std::string & name)
+    {
+        if ("xxh64" == name) {
+            return Algorithm::Xxh64;
+        }
+
+        if ("crc32c" == name) {
+            return Algorithm::Crc32c;
+        }
+
+        throw std::runtime_error(std::format("Unrecognised checksum algorithm \"{}\"", name));
+    }
+
+    /**
+     * Parse the command-line arguments into a set of Options.
+     *
+     * @param args
+     * @return The parsed options.
+     * @throws std::runtime_error if the args are not valid.
+     */
+    Options parseArguments(const ActionArguments & args)
+    {
+        Options opts;
+
+        for (auto it = args.cbegin(); it != args.cend(); ++it) {
+            const auto & arg = *it;
+
+            if ("-v" == arg || "--verbose" == arg) {
+                opts.verbose = true;
+            } else if ("-j" == arg || "--checksums" == arg || "--manifest" == arg || "--write-manifest" == arg) {
+                if (args.cend() == it + 1) {
+                    throw std::runtime_error(std::format("Expected argument for {}", arg));
+                }
+
+                ++it;
+
+                if ("-j" == arg) {
+                    try {
+                        opts.threads = static_cast<unsigned int>(std::stoul(*it));
+                    } catch (const std::logic_error &) {
+                        throw std::runtime_error(std::format("Invalid thread count \"{}\"", *it));
+                    }
+                } else if ("--checksums" == arg) {
+                    opts.algorithm = parseAlgorithm(*it);
+                } else if ("--manifest" == arg) {
+                    opts.manifest = *it;
+                } else {
+                    opts.writeManifest = *it;
+                }
+            } else {
+                opts.pacFileNames.push_back(arg);
+            }
+        }
+
+        if (opts.pacFileNames.empty()) {
+            throw std::runtime_error("You must provide at least one pac file to verify.");
+        }
+
+        if ((!opts.manifest.empty() || !opts.writeManifest.empty()) && 1 != opts.pacFileNames.size()) {
+            throw std::runtime_error("Only one pac file can be verified against or write a manifest.");
+        }
+
+        return opts;
+    }
+
+    /**
+     * Read a manifest file.
+     *
+     * @throws std::runtime_error if the file can't be read or a line isn't a checksum followed by a file name.
+     */
+    Manifest readManifest(const std::string & fileName)
+    {
+        auto in = std::ifstream(fileName);
+
+        if (!in) {
+            throw std::runtime_error(std::format("Error opening manifest \"{}\"", fileName));
+        }
+
+        Manifest manifest;
+        std::string line;
+
+        for (int lineNumber = 1; std::getline(in, line); ++lineNumber) {
+            if (line.empty()) {
+                continue;
+            }
+
+            const auto separator = line.find("  ");
+
+            if (std::string::npos == separator || 0 == separator || line.size() == separator + 2) {
+                throw std::runtime_error(std::format("Invalid manifest line {} in \"{}\"", lineNumber, fileName));
+            }
+
+            manifest.insert_or_assign(line.substr(separator + 2), line.substr(0, separator));
+        }
+
+        return manifest;
+    }
+
+    /**
+     * Work out the algorithm a manifest's checksums were computed with, from their length.
+     *
+     * @throws std::runtime_error if the checksums are not all of the same recognised length.
+     */
+    Algorithm manifestAlgorithm(const Manifest & manifest)
+    {
+        std::optional<std::size_t> length;
+
+        for (const auto & [name, checksum] : manifest) {
+            if (length && *length != checksum.size()) {
+                throw std::runtime_error("The manifest checksums are not all of the same type");
+            }
+
+            length = checksum.size();
+        }
+
+        return (8 == length.value_or(16) ? Algorithm::Crc32c : Algorithm::Xxh64);
+    }
+
+    /** Format a checksum as it appears in a manifest. */
+    std::string formatChecksum(Algorithm algorithm, std::uint64_t checksum)
+    {
+        return (Algorithm::Crc32c == algorithm ? std::format("{:08x}", checksum) : std::format("{:016x}", checksum));
+    }
+
+    /**
+     * Compute the checksum of a range of an archive, a chunk at a time.
+     *
+     * @param buffer The buffer into which to read each chunk.
+     * @throws std::runtime_error if the data can't be read.
+     */
+    std::string checksum(const Id::Pack::Source & source, std::uint64_t offset, std::uint64_t size, Algorithm algorithm, std::string & buffer)
+    {
+        Id::Pack::Xxh64 xxh64;
+        std::uint32_t crc32c = 0;
+
+        while (0 < size) {
+            const auto bytes = std::min<std::uint64_t>(size, buffer.size());
+            source.read(offset, buffer.data(), bytes);
+            const auto chunk = std::string_view(buffer.data(), bytes);
+
+            if (Algorithm::Crc32c == algorithm) {
+                crc32c = Id::Pack::crc32c(chunk, crc32c);
+            } else {
+                xxh64.update(chunk);
+            }
+
+            offset += bytes;
+            size -= bytes;
+        }
+
+        return formatChecksum(algorithm, (Algorithm::Crc32c == algorithm ? crc32c : xxh64.digest()));
+    }
+
+    /** The outcome of computing the checksum of a file, one of which is empty. */
+    struct ChecksumResult
+    {
+        std::string checksum;
+        std::string error;
+    };
+
+    /**
+     * Compute the checksums of a set of files in an archive in parallel.
+     *
+     * Each worker takes the next file from the set until none remain, so that large files don't hold up the rest.
+     *
+     * @param files The indices of the files whose checksums are required, in the order in which they're stored.
+     * @return The results, indexed by file index. Files not in the set have empty results.
+     */
+    template<class Reader>
+    std::vector<ChecksumResult> checksums(const Reader & reader, const std::vector<int> & files, const Options & opts)
+    {
+        std::vector<ChecksumResult> results(reader.fileCount());
+        std::atomic<std::size_t> next = 0;
+        auto threads = (0 == opts.threads ? std::max(1u, std::thread::hardware_concurrency()) : opts.threads);
+        threads = std::min<std::size_t>(threads, std::max<std::size_t>(1, files.size()));
+
+        const auto work = [&]() {
+            std::string buffer(ChunkSize, 0);
+
+            for (auto item = next++; item < files.size(); item = next++) {
+                const auto idx = files[item];
+                const auto offset = static_cast<std::uint32_t>(reader.fileOffset(idx));
+                const auto size = static_cast<std::uint32_t>(reader.storedSize(idx));
+
+                try {
+                    results[idx].checksum = checksum(*reader.source(), offset, size, opts.algorithm, buffer);
+                } catch (const std::runtime_error & err) {
+                    results[idx].error = err.what();
+                }
+            }
+        };
+
+        {
+            std::vector<std::jthread> workers;
+
+            for (unsigned int thread = 0; thread < threads; ++thread) {
+                workers.emplace_back(work);
+            }
+        }
+
+        return results;
+    }
+
+    /**
+     * Verify an archive with the reader for its layout.
+     *
+     * @return The number of problems found.
+     */
+    template<class Reader>
+    int verify(const Reader & reader, const std::string & pacFileName, const Options & opts, const std::optional<Manifest> & manifest)
+    {
+        using Layout = typename Reader::LayoutType;
+        int problems = 0;
+
+        const auto problem = [&](const std::string & message) {
+            error(std::format(R"("{}": {})", pacFileName, message));
+            ++problems;
+        };
+
+        const auto archiveSize = reader.source()->size();
+        const std::uint64_t indexStart = reader.indexOffset();
+        const std::uint64_t indexEnd = indexStart + reader.indexSize();
+
+        if (HeaderSize > indexStart || archiveSize < indexEnd) {
+            problem(std::format("the index ({} bytes @ {:#010x}) lies outside the archive ({} bytes)", reader.indexSize(), indexStart, archiveSize));
+            return problems;
+        }
+
+        if (0 != reader.indexSize() % Layout::EntrySize) {
+            problem(std::format("the index size {} is not a multiple of the entry size {}", reader.indexSize(), Layout::EntrySize));
+        }
+
+        // the reader loads no entries from an index that it can't use
+        if (0 < reader.indexSize() / Layout::EntrySize && 0 == reader.fileCount()) {
+            problem(std::format("the index has an entry with an unrecognised codec or an uncompressed entry whose stored size isn't its size, so none of its {} entries can be read", reader.indexSize() / Layout::EntrySize));
+            return problems;
+        }
+
+        // the files whose content lies within the archive, in the order it's stored
+        std::vector<int> intact;
+        intact.reserve(reader.fileCount());
+
+        for (int idx = 0; idx < reader.fileCount(); ++idx) {
+            const auto name = reader.fileName(idx);
+            const std::uint64_t offset = static_cast<std::uint32_t>(reader.fileOffset(idx));
+            const std::uint64_t storedSize = static_cast<std::uint32_t>(reader.storedSize(idx));
+            const auto codec = reader.fileCodec(idx);
+            bool inBounds = true;
+
+            const auto fileProblem = [&](const std::string & message) {
+                problem(std::format(R"(file {} "{}" {})", idx, name, message));
+            };
+
+            if (name.empty()) {
+                fileProblem("has an empty name");
+            } else if (Layout::NameLength <= name.size()) {
+                fileProblem("has a name that is not NUL-terminated");
+            }
+
+            if (std::ranges::any_of(name, [](unsigned char ch) { return 0x20 > ch || 0x7f == ch; })) {
+                fileProblem("has a name containing control characters");
+            }
+
+            if (HeaderSize > offset || archiveSize < offset + storedSize) {
+                fileProblem(std::format("({} bytes @ {:#010x}) lies outside the archive", storedSize, offset));
+                inBounds = false;
+            } else if (0 < storedSize && offset < indexEnd && indexStart < offset + storedSize) {
+                fileProblem(std::format("({} bytes @ {:#010x}) overlaps the index", storedSize, offset));
+            }
+
+            if ("unknown" == Id::Pack::codecName(codec)) {
+                fileProblem(std::format("uses unknown codec {}", static_cast<int>(codec)));
+            } else if (Id::Pack::Codec::None == codec && storedSize != static_cast<std::uint32_t>(reader.fileSize(idx))) {
+                fileProblem("is not compressed, but its stored size differs from its size");
+            }
+
+            if (inBounds) {
+                intact.push_back(idx);
+            }
+        }
+
+        if (Algorithm::None == opts.algorithm) {
+            return problems;
+        }
+
+        std::ranges::sort(intact, {}, [&reader](int idx) { return static_cast<std::uint32_t>(reader.fileOffset(idx)); });
+        const auto results = checksums(reader, intact, opts);
+
+        // as with lookups by name, the last file with any given name is the one compared with the manifest
+        std::map<std::string, int, std::less<>> filesByName;
+
+        for (int idx = 0; idx < reader.fileCount(); ++idx) {
+            const auto & result = results[idx];
+            filesByName.insert_or_assign(reader.fileName(idx), idx);
+
+            if (!result.error.empty()) {
+                problem(std::format(R"(file {} "{}" can't be read: {})", idx, reader.fileName(idx), result.error));
+            } else if (opts.verbose && !result.checksum.empty()) {
+                std::cout << std::format("{}  {}", result.checksum, reader.fileName(idx)) << "\n";
+            }
+        }
+
+        if (manifest) {
+            for (const auto & [name, expected] : *manifest) {
+                const auto file = filesByName.find(name);
+
+                if (filesByName.end() == file) {
+                    problem(std::format(R"(file "{}" in the manifest is missing)", name));
+                } else if (const auto & actual = results[file->second].checksum; !actual.empty() && actual != expected) {
+                    problem(std::format(R"(file "{}" has checksum {}, expected {})", name, actual, expected));
+                }
+            }
+
+            for (const auto & [name, idx] : filesByName) {
+                if (!manifest->contains(name)) {
+                    problem(std::format(R"(file "{}" is not in the manifest)", name));
+                }
+            }
+        }
+
+        if (!opts.writeManifest.empty()) {
+            auto out = std::ofstream(opts.writeManifest);
+
+            for (const auto & [name, idx] : filesByName) {
+                if (!results[idx].checksum.empty()) {
+                    out << results[idx].checksum << "  " << name << "\n";
+                }
+            }
+
+            if (out.fail()) {
+                throw std::runtime_error(std::format("Error writing manifest \"{}\"", opts.writeManifest));
+            }
+        }
+
+        return problems;
+    }
+}
+
+
+/**
+ * Verify the integrity of one or more ID PACK archives.
+ *
+ * @param args The command-line arguments provided to the verify action.
+ *
+ * @return ExitCode::Ok if the archives are intact, ExitCode::VerificationFailed if any problems were found, another
+ * ExitCode if the command is not valid.
+ */
+int Id::Pack::Tools::PackFile::Actions::verify(const ActionArguments & args) noexcept
+{
+    Options opts;
+    std::optional<Manifest> manifest;
+
+    try {
+        opts = parseArguments(args);
+
+        if (!opts.manifest.empty()) {
+            manifest = readManifest(opts.manifest);
+
+            if (Algorithm::None == opts.algorithm) {
+                opts.algorithm = manifestAlgorithm(*manifest);
+            }
+        } else if (!opts.writeManifest.empty() && Algorithm::None == opts.algorithm) {
+            opts.algorithm = Algorithm::Xxh64;
+        }
+    } catch (const std::runtime_error & err) {
+        error(err.what());
+        usage();
+        return ExitCode::InvalidArgument;
+    }
+
+    int problems = 0;
+
+    for (const auto & pacFileName : opts.pacFileNames) {
+        try {
+            const auto found = withReader(pacFileName, [&](const auto & reader) {
+                return ::verify(reader, pacFileName, opts, manifest);
+            });
+
+            if (0 == found) {
+                info(std::format(R"("{}": OK)", pacFileName));
+            }
+
+            problems += found;
+        } catch (const std::exception & err) {
+            error(std::format(R"(Failed verifying PACK file "{}": {})", pacFileName, err.what()));
+            ++problems;
+        }
+    }
+
+    return (0 == problems ? ExitCode::Ok : ExitCode::VerificationFailed);
+}
@@ -0,0 +1,11 @@
+#ifndef TOOLS_PACKFILE_ACTION_VERIFY_H
+#define TOOLS_PACKFILE_ACTION_VERIFY_H
+
+#include "../actions.h"
+
+namespace Id::Pack::Tools::PackFile::Actions
+{
+    int verify(const ActionArguments &args) noexcept;
+}
+
+#endif
@@ -3,6 +3,14 @@
 #include "actions.h"
 #include "actions/list.h"
 #include "actions/extract.h"
+#include "actions/create.h"
+#include "actions/verify.h"
+#include "actions/diff.h"
+#include "actions/grep.h"
+#include "actions/totar.h"
+#include "actions/serve.h"
+#include "actions/reorder.h"
+#include "actions/bench.h"
 #include "../ExitCode.h"
 #include "../output.h"
 
@@ -20,6 +28,14 @@ const ActionList & actions() noexcept
     if (actions.empty()) {
         actions.emplace_back("list", "List the files in one or more PACK file(s)", Actions::list);
         actions.emplace_back("extract", "Extract one or more files from a single PACK file", Actions::extract);
+        actions.emplace_back("create", "Create a PACK file from files and directories", Actions::create);
+        actions.emplace_back("verify", "Check the integrity of one or more PACK file(s)", Actions::verify);
+        actions.emplace_back("diff", "List the files that differ between two PACK files", Actions::diff);
+        actions.emplace_back("grep", "Search the content of the files in one or more PACK file(s)", Actions::grep);
+        actions.emplace_back("totar", "Write the files in a PACK file to stdout as a tar stream", Actions::toTar);
+        actions.emplace_back("serve", "Serve the files in one or more PACK file(s) over HTTP", Actions::serve);
+        actions.emplace_back("reorder", "Store the files in a PACK file in the order they were accessed in a trace", Actions::reorder);
+        actions.emplace_back("bench", "Measure the throughput and latency of reading a PACK file", Actions::bench);
     }
 
     return actions;